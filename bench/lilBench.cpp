@@ -0,0 +1,785 @@
+#include <lilGUI.h>
+#include <lilProfiler.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+/*
+--------------------------------------------------
+----- SECTION (LilBench) -------------------------
+--------------------------------------------------
+
+Console benchmarks for the CPU-side paths of the library.
+They don't need a window or a GL context.
+
+Every result is one row: the benchmark, its variant, how
+many primitives one iteration handles, the best time per
+primitive over all iterations, the bytes of output per
+primitive and the heap allocations per iteration (frame).
+Some rows add one metric of their own (e.g. atlas density).
+Run with --json to get one JSON object per line instead of
+the table, which is what regression tooling should parse.
+Built with LIL_PROFILE, the run also writes its zones to
+lilBench.trace.json.
+
+Before any numbers, the batched UTF-8 decoder is checked
+against the scalar one and PushRects against PushRect; a
+mismatch is printed to stderr and the run exits with status
+1, so CI catches it either way.
+*/
+
+static bool s_Json = false;
+
+static void Report(const char* bench, const char* variant, std::size_t prims, double bestMs, double bytesPerPrim, double allocsPerIter,
+                   const char* extraName = nullptr, double extraValue = 0.0)
+{
+  const double nsPerPrim = bestMs * 1e6 / static_cast<double>(prims);
+  
+  if (s_Json)
+  {
+    std::printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"prims\":%zu,\"ns_per_prim\":%.3f,\"bytes_per_prim\":%.2f,\"allocs_per_iter\":%.2f",
+                bench, variant, prims, nsPerPrim, bytesPerPrim, allocsPerIter);
+    if (extraName)
+      std::printf(",\"%s\":%.3f", extraName, extraValue);
+    std::printf("}\n");
+    return;
+  }
+  
+  std::printf("%-16s %-22s %9zu %12.3f %14.2f %16.2f", bench, variant, prims, nsPerPrim, bytesPerPrim, allocsPerIter);
+  if (extraName)
+    std::printf("   %s=%.3f", extraName, extraValue);
+  std::printf("\n");
+}
+
+static std::size_t GetHeapCalls()
+{
+  const LilAllocatorStats stats = LilHeapAllocator::GetStats();
+  return stats.Allocations + stats.Reallocations;
+}
+
+// Times fn over iterations runs and keeps the best, counting heap calls over all of them.
+// One untimed warm-up run comes first, so reused containers are measured at their steady state.
+struct LilBenchTimer
+{
+  double BestMs = 1e30;
+  std::size_t HeapCalls = 0;
+  int Iterations = 0;
+
+  template <typename Fn>
+  void Run(int iterations, Fn fn)
+  {
+    fn();
+
+    for (int i = 0; i < iterations; ++i)
+    {
+      std::size_t heapCalls = GetHeapCalls();
+      auto start = std::chrono::steady_clock::now();
+
+      fn();
+
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      BestMs = ms < BestMs ? ms : BestMs;
+      HeapCalls += GetHeapCalls() - heapCalls;
+      ++Iterations;
+    }
+  }
+
+  double AllocsPerIter() const { return Iterations ? static_cast<double>(HeapCalls) / Iterations : 0.0; }
+};
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilArray) ------------------
+--------------------------------------------------
+*/
+
+// Same layout as LilVtx, but the user-provided copy constructor makes it non-trivially
+// copyable, which forces LilArray back onto its element-wise move/destroy growth path.
+struct LilBenchVtx : LilVtx
+{
+  using LilVtx::LilVtx;
+
+  LilBenchVtx(const LilBenchVtx& other)
+    : LilVtx(other) {}
+};
+
+template <typename T>
+static void BenchArrayGrowth(const char* variant, std::size_t count, int iterations)
+{
+  LilBenchTimer timer;
+  timer.Run(iterations, [count]() {
+    LilArray<T> array;
+    for (std::size_t j = 0; j < count; ++j)
+      array.EmplaceBack(LilVec3(static_cast<float>(j), 0.0f, 0.0f), LilVec2(0.0f, 0.0f), 0xffffffff);
+  });
+
+  Report("array_growth", variant, count, timer.BestMs, sizeof(T), timer.AllocsPerIter());
+}
+
+// Steady-state push throughput: the array keeps its capacity, so only PushBack itself is measured
+static void BenchArrayPush(std::size_t count, int iterations)
+{
+  LilArray<LilVtx> array;
+  array.Reserve(count);
+
+  LilBenchTimer timer;
+  timer.Run(iterations, [&array, count]() {
+    array.Shrink(0);
+    for (std::size_t j = 0; j < count; ++j)
+      array.PushBack(LilVtx(LilVec3(static_cast<float>(j), 0.0f, 0.0f), LilVec2(0.0f, 0.0f), 0xffffffff));
+  });
+
+  Report("array_push", "reserved", count, timer.BestMs, sizeof(LilVtx), timer.AllocsPerIter());
+}
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilDrawList) ---------------
+--------------------------------------------------
+*/
+
+struct LilBenchRects
+{
+  LilArray<float> X, Y, W, H;
+  LilArray<LilU32> Colors;
+
+  // A 256 wide grid of small rects covering the viewport, wrapping for larger counts
+  LilBenchRects(int count)
+  {
+    for (int j = 0; j < count; ++j)
+    {
+      X.PushBack(static_cast<float>(j % 256) / 128.0f - 1.0f);
+      Y.PushBack(static_cast<float>(j / 256 % 256) / 128.0f - 1.0f);
+      W.PushBack(0.005f);
+      H.PushBack(0.005f);
+      Colors.PushBack(0xff00ffff);
+    }
+  }
+};
+
+static double GetBytesPerPrim(const LilDrawList& drawList, std::size_t prims)
+{
+  std::size_t bytes = drawList.VtxArray.GetSize() * sizeof(LilVtx) +
+                      drawList.IdxArray.GetSize() * sizeof(LilIdx) +
+                      drawList.RectArray.GetSize() * sizeof(LilRectInstance);
+  return static_cast<double>(bytes) / static_cast<double>(prims);
+}
+
+static const char* GetFlagsName(LilDrawListFlags flags)
+{
+  if (flags & LilDrawListFlags_RectInstancing)
+    return "rect_instances";
+  if (flags & LilDrawListFlags_QuadIndexing)
+    return "shared_quad_indices";
+  return "indexed_quads";
+}
+
+static void BenchRectEmission(const LilBenchRects& rects, LilDrawListFlags flags, int iterations)
+{
+  const int count = static_cast<int>(rects.X.GetSize());
+  LilDrawList drawList;
+  drawList.Flags = flags;
+
+  LilBenchTimer timer;
+  timer.Run(iterations, [&]() {
+    drawList.Clear();
+    for (int j = 0; j < count; ++j)
+      drawList.PushRect(LilVec2(rects.X[j], rects.Y[j]), LilVec2(rects.X[j] + rects.W[j], rects.Y[j] + rects.H[j]), rects.Colors[j]);
+    drawList.Render();
+  });
+
+  Report("push_rect", GetFlagsName(flags), count, timer.BestMs, GetBytesPerPrim(drawList, count), timer.AllocsPerIter());
+}
+
+static void BenchRectBatch(const LilBenchRects& rects, LilDrawListFlags flags, int iterations)
+{
+  const int count = static_cast<int>(rects.X.GetSize());
+  LilDrawList drawList;
+  drawList.Flags = flags;
+
+  LilBenchTimer timer;
+  timer.Run(iterations, [&]() {
+    drawList.Clear();
+    drawList.PushRects(&rects.X[0], &rects.Y[0], &rects.W[0], &rects.H[0], &rects.Colors[0], count);
+    drawList.Render();
+  });
+
+  Report("push_rects", GetFlagsName(flags), count, timer.BestMs, GetBytesPerPrim(drawList, count), timer.AllocsPerIter());
+}
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilFont) -------------------
+--------------------------------------------------
+*/
+
+// Building the built-in atlas; primitives are glyphs and bytes are atlas texels per glyph
+static void BenchFontAtlas(int iterations)
+{
+  LilFont font;
+  LilBenchTimer timer;
+  timer.Run(iterations, [&font]() { font.BuildDefault(); });
+  
+  const std::size_t glyphs = 95;
+  Report("font_atlas", "builtin_8x8", glyphs, timer.BestMs, static_cast<double>(font.AtlasPixels.GetSize()) / glyphs, timer.AllocsPerIter(), "density", font.PackingDensity);
+  
+  // Distance fields at 8 texels per font pixel, generated on one thread and on all of them
+  const int threadCounts[2] = { 1, 0 };
+  const char* variants[2] = { "sdf_builtin_1thread", "sdf_builtin_threads" };
+  for (int i = 0; i < 2; ++i)
+  {
+    LilBenchTimer sdfTimer;
+    sdfTimer.Run(iterations / 10 + 1, [&font, &threadCounts, i]() { font.BuildDefaultDistanceField(8, 4, threadCounts[i]); });
+    Report("font_atlas", variants[i], glyphs, sdfTimer.BestMs, static_cast<double>(font.AtlasPixels.GetSize()) / glyphs, sdfTimer.AllocsPerIter(), "density", font.PackingDensity);
+  }
+}
+
+// Lines of printable ASCII through PushText, primitives are glyphs
+static void BenchTextEmission(LilFont& font, LilDrawListFlags flags, int iterations)
+{
+  char line[96];
+  for (int i = 0; i < 95; ++i)
+    line[i] = static_cast<char>(' ' + (i * 7) % 95);
+  line[95] = '\0';
+  
+  const int lines = 1000;
+  LilDrawList drawList;
+  drawList.Flags = flags;
+  
+  LilBenchTimer timer;
+  timer.Run(iterations, [&]() {
+    drawList.Clear();
+    for (int j = 0; j < lines; ++j)
+      drawList.PushText(font, LilVec2(-1.0f, 1.0f - j * 0.002f), LilVec2(0.002f, 0.002f), line, line + 95);
+    drawList.Render();
+  });
+  
+  const std::size_t glyphs = 95 * lines;
+  Report("push_text", GetFlagsName(flags), glyphs, timer.BestMs, GetBytesPerPrim(drawList, glyphs), timer.AllocsPerIter(), "draw_cmds", static_cast<double>(drawList.DrawCmds.GetSize()));
+}
+
+// Stand-in for a TTF rasterizer: a 12x12 pattern per codepoint, no glyphs below U+3000
+static bool BenchGlyphSource(void* /*userData*/, LilU32 codepoint, LilGlyphBitmap& bitmap)
+{
+  static unsigned char pixels[12 * 12];
+  if (codepoint < 0x3000)
+    return false;
+  
+  for (int i = 0; i < 12 * 12; ++i)
+    pixels[i] = ((codepoint * 2654435761u) >> (i % 29)) & 1 ? 0xff : 0x00;
+  
+  bitmap.Width = bitmap.Height = 12;
+  bitmap.OffsetX = 0.0f;
+  bitmap.OffsetY = -2.0f;
+  bitmap.AdvanceX = 12.0f;
+  bitmap.Pixels = pixels;
+  return true;
+}
+
+// UTF-8 CJK text through the glyph cache. The working set either fits the cache (every lookup
+// after the first frame hits) or is about three times larger (shelves are evicted and glyphs rasterized
+// every frame). Primitives are glyphs, the extra metric is the hit rate of the last frame.
+static void BenchGlyphCache(const char* variant, int distinctGlyphs, int cacheWidth, int cacheHeight, int iterations)
+{
+  LilFont font;
+  font.BuildDefault();
+  font.EnableGlyphCache(BenchGlyphSource, nullptr, cacheWidth, cacheHeight);
+  
+  // Each frame draws the whole working set, in 3 byte UTF-8 sequences
+  LilArray<char> text;
+  for (int i = 0; i < distinctGlyphs; ++i)
+  {
+    const LilU32 codepoint = 0x4e00 + static_cast<LilU32>(i);
+    text.PushBack(static_cast<char>(0xe0 | (codepoint >> 12)));
+    text.PushBack(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+    text.PushBack(static_cast<char>(0x80 | (codepoint & 0x3f)));
+  }
+  
+  LilDrawList drawList;
+  LilArray<LilAtlasRect> updates;
+  std::size_t hits = 0, misses = 0;
+  
+  LilBenchTimer timer;
+  timer.Run(iterations, [&]() {
+    font.NewFrame();
+    hits = font.Cache.Hits;
+    misses = font.Cache.Misses;
+    
+    drawList.Clear();
+    drawList.PushText(font, LilVec2(-1.0f, 1.0f), LilVec2(0.001f, 0.001f), &text[0], &text[0] + text.GetSize());
+    drawList.Render();
+    
+    updates.Shrink(0);
+    font.TakeAtlasUpdates(updates);
+    hits = font.Cache.Hits - hits;
+    misses = font.Cache.Misses - misses;
+  });
+  
+  Report("glyph_cache", variant, distinctGlyphs, timer.BestMs, static_cast<double>(font.AtlasPixels.GetSize()) / distinctGlyphs, timer.AllocsPerIter(),
+         "hit_rate", static_cast<double>(hits) / static_cast<double>(hits + misses));
+}
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilContext) ----------------
+--------------------------------------------------
+*/
+
+// Whole BeginFrame / Lil::Rect / RenderFrame cycles. Allocations per frame show whether
+// a steady-state frame touches the heap at all.
+static void BenchFrame(const LilBenchRects& rects, LilDrawListFlags flags, int iterations)
+{
+  const int count = static_cast<int>(rects.X.GetSize());
+  Lil::GetDrawLists()[0].Flags = flags;
+
+  auto frame = [&]() {
+    Lil::BeginFrame();
+    for (int j = 0; j < count; ++j)
+      Lil::Rect(rects.X[j], rects.Y[j], rects.W[j], rects.H[j], rects.Colors[j]);
+    Lil::RenderFrame();
+  };
+
+  LilBenchTimer timer;
+  timer.Run(iterations, frame);
+
+  char variant[64];
+  std::snprintf(variant, sizeof(variant), "%s/%dk", GetFlagsName(flags), count / 1000);
+  Report("frame", variant, count, timer.BestMs, static_cast<double>(Lil::GetFrameStats().Bytes) / count, timer.AllocsPerIter());
+}
+
+// The same frame split into panels, each recorded into its own draw list. Workers take every
+// threads-th panel (at most 8 threads), so the single threaded variant does the same work.
+static void BenchPanelFrame(const LilBenchRects& rects, int panels, int threads, int iterations)
+{
+  const int count = static_cast<int>(rects.X.GetSize());
+  const int perPanel = count / panels;
+  
+  auto record = [&](int first) {
+    for (int panel = first; panel < panels; panel += threads)
+    {
+      LIL_PROFILE_SCOPE("lilBench::Panel");
+      LilDrawListScope scope(Lil::GetPanelDrawList(panel));
+      for (int j = panel * perPanel; j < (panel + 1) * perPanel; ++j)
+        Lil::Rect(rects.X[j], rects.Y[j], rects.W[j], rects.H[j], rects.Colors[j]);
+    }
+  };
+  
+  auto frame = [&]() {
+    Lil::BeginFrame();
+    Lil::SetPanelCount(panels);
+    
+    std::thread workers[8];
+    for (int t = 1; t < threads; ++t)
+      workers[t] = std::thread(record, t);
+    record(0);
+    for (int t = 1; t < threads; ++t)
+      workers[t].join();
+    
+    Lil::RenderFrame();
+  };
+  
+  LilBenchTimer timer;
+  timer.Run(iterations, frame);
+  Lil::SetPanelCount(0);
+  
+  char variant[64];
+  std::snprintf(variant, sizeof(variant), "%dpanels/%dthreads", panels, threads);
+  Report("panel_frame", variant, perPanel * panels, timer.BestMs, static_cast<double>(Lil::GetFrameStats().Bytes) / (perPanel * panels), timer.AllocsPerIter());
+}
+
+// UTF-8 decoding of a 4 MB log, one codepoint at a time or in batches with the ASCII fast path.
+// "mixed" puts a 2 and a 3 byte sequence into every line. Primitives are bytes.
+static void BenchDecodeUTF8(const char* variant, bool batched, bool mixed, int iterations)
+{
+  const char* line = mixed ? "12:00:01.337 [worker-3] caf\xc3\xa9 \xe2\x86\x92 request served in 12 ms, 200 OK\n"
+                           : "12:00:01.337 [worker-3] cafe -> request served in 12 ms, 200 OK\n";
+  const std::size_t lineLength = std::strlen(line);
+  LilArray<char> text;
+  while (text.GetSize() + lineLength <= (4u << 20))
+  {
+    char* dst = text.Append(lineLength);
+    std::memcpy(dst, line, lineLength);
+  }
+
+  LilArray<LilU32> codepoints;
+  codepoints.Resize(256);
+  volatile LilU32 checksum = 0; // Keeps the decoded codepoints alive
+
+  LilBenchTimer timer;
+  timer.Run(iterations, [&]() {
+    const char* src = text.begin();
+    const char* end = text.end();
+    while (src < end)
+    {
+      if (batched)
+      {
+        const std::size_t count = Lil::DecodeUTF8(src, end, codepoints.begin(), codepoints.GetSize());
+        checksum += codepoints[count - 1];
+      }
+      else
+        checksum += Lil::DecodeUTF8(src, end);
+    }
+  });
+
+  const double gbPerSecond = static_cast<double>(text.GetSize()) / (timer.BestMs * 1e6);
+  Report("utf8_decode", variant, text.GetSize(), timer.BestMs, 0.0, timer.AllocsPerIter(), "gb_per_s", gbPerSecond);
+}
+
+// Decodes text with the scalar decoder and in batches of capacity codepoints, and compares the
+// codepoints and where every batch left the text pointer. Texts are at most 1024 bytes.
+static bool MatchesScalarDecode(const char* text, std::size_t length, std::size_t capacity)
+{
+  LilU32 expected[1024], decoded[1024];
+  const char* ends[1024];
+  std::size_t expectedCount = 0;
+  for (const char* src = text; src < text + length;)
+  {
+    expected[expectedCount] = Lil::DecodeUTF8(src, text + length);
+    ends[expectedCount++] = src;
+  }
+  
+  std::size_t count = 0;
+  for (const char* src = text; src < text + length;)
+  {
+    const std::size_t batch = Lil::DecodeUTF8(src, text + length, decoded + count, capacity);
+    if (batch == 0 || count + batch > expectedCount || src != ends[count + batch - 1])
+      return false;
+    count += batch;
+  }
+  
+  return count == expectedCount && std::memcmp(decoded, expected, count * sizeof(LilU32)) == 0;
+}
+
+// Xorshift, so the self-checks see the same inputs on every run and platform
+static LilU32 NextRandom(LilU32& state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// Self-check of the batched UTF-8 decoder (whichever SIMD path this build uses) against the scalar
+// one. Every sequence is put after ASCII runs of every length up to past the 256 codepoint batch, so
+// it lands on both sides of every 16 and 32 byte block edge, and is either followed by more ASCII or
+// cut off by the end of the text. Random texts cover the rest.
+static bool CheckDecodeUTF8()
+{
+  static const char* const sequences[] = {
+    "\xc3\xa9", "\xe2\x86\x92", "\xf0\x9f\x98\x80", // Valid 2, 3 and 4 byte sequences
+    "\xc3", "\xe2\x86", "\xf0\x9f\x98", // Truncated
+    "\xc0\x80", "\xe0\x80\x80", "\xf0\x80\x80\x80", // Overlong
+    "\xed\xa0\x80", "\xed\xbf\xbf", "\xf4\x90\x80\x80", // Surrogates and past U+10FFFF
+    "\x80", "\xbf\xbf", "\xff", // Stray continuation and invalid bytes
+  };
+  const std::size_t capacities[] = { 256, 17, 1 };
+  
+  char text[1024];
+  for (std::size_t s = 0; s < sizeof(sequences) / sizeof(sequences[0]); ++s)
+  {
+    const char* sequence = sequences[s];
+    const std::size_t sequenceLength = std::strlen(sequence);
+    for (std::size_t prefix = 0; prefix <= 300; ++prefix)
+    {
+      for (std::size_t suffix : { std::size_t(0), std::size_t(40) })
+      {
+        for (std::size_t i = 0; i < prefix; ++i)
+          text[i] = static_cast<char>('!' + i % 90);
+        std::memcpy(text + prefix, sequence, sequenceLength);
+        for (std::size_t i = 0; i < suffix; ++i)
+          text[prefix + sequenceLength + i] = static_cast<char>('a' + i % 26);
+        
+        for (std::size_t capacity : capacities)
+        {
+          if (MatchesScalarDecode(text, prefix + sequenceLength + suffix, capacity))
+            continue;
+          std::fprintf(stderr, "utf8_decode check failed: sequence %zu after %zu ASCII bytes, capacity %zu\n", s, prefix, capacity);
+          return false;
+        }
+      }
+    }
+  }
+  
+  // Long ASCII runs broken up by bytes that start, continue or break multibyte sequences
+  const unsigned char pool[] = { 0xc3, 0xa9, 0xe2, 0x86, 0x92, 0xf0, 0x9f, 0x98, 0x80, 0xbf, 0xc0, 0xed, 0xa0, 0xf4, 0x90, 0xff, '\n', ' ' };
+  LilU32 state = 0x9e3779b9u;
+  auto random = [&state]() { return NextRandom(state); };
+  
+  for (int t = 0; t < 20000; ++t)
+  {
+    const std::size_t length = random() % 700;
+    const LilU32 asciiOdds = 1 + random() % 64;
+    for (std::size_t i = 0; i < length; ++i)
+      text[i] = random() % asciiOdds ? static_cast<char>('!' + random() % 90) : static_cast<char>(pool[random() % sizeof(pool)]);
+    
+    const std::size_t capacity = 1 + random() % 300;
+    if (!MatchesScalarDecode(text, length, capacity))
+    {
+      std::fprintf(stderr, "utf8_decode check failed: random text %d, capacity %zu\n", t, capacity);
+      return false;
+    }
+  }
+  
+  return true;
+}
+
+template <typename Array>
+static bool SameBytes(const Array& a, const Array& b)
+{
+  return a.GetSize() == b.GetSize() && (a.Empty() || std::memcmp(&a[0], &b[0], a.GetSize() * sizeof(a[0])) == 0);
+}
+
+// Self-check of PushRects (whichever SIMD path this build uses) against PushRect with the same rects,
+// for every primitive stream: vertices, indices, instances, commands and the culled count must all be
+// identical. Coordinates and sizes are picked so rects often land exactly on a cull edge, straddle it,
+// are empty or inverted, or are too thin to survive x + w, at counts that leave partial SIMD groups
+// and span several batches.
+static bool CheckPushRects()
+{
+  const LilDrawListFlags modes[] = { LilDrawListFlags_None, LilDrawListFlags_QuadIndexing, LilDrawListFlags_RectInstancing };
+  const LilVec4 clips[] = { Lil::NoClipRect, LilVec4(-0.5f, -0.25f, 0.5f, 0.75f), LilVec4(0.1f, -1.0f, 0.3f, 0.1f), LilVec4(0.5f, 0.5f, 0.25f, 0.75f) };
+  const float edges[] = { -1.0f, -0.5f, -0.25f, 0.0f, 0.1f, 0.25f, 0.3f, 0.5f, 0.75f, 1.0f };
+  const std::size_t edgeCount = sizeof(edges) / sizeof(edges[0]);
+  LilU32 state = 0x2545f491u;
+  auto random = [&state]() { return NextRandom(state); };
+  auto unit = [&random]() { return static_cast<float>(random() % 65536) / 65536.0f; };
+  
+  LilArray<float> xs, ys, ws, hs;
+  LilArray<LilU32> colors;
+  LilDrawList single, batched;
+  
+  for (int t = 0; t < 2000; ++t)
+  {
+    const std::size_t count = 1 + random() % 600;
+    xs.Resize(count);
+    ys.Resize(count);
+    ws.Resize(count);
+    hs.Resize(count);
+    colors.Resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      float* const position[2] = { &xs[i], &ys[i] };
+      float* const size[2] = { &ws[i], &hs[i] };
+      for (int axis = 0; axis < 2; ++axis)
+      {
+        const float edge = edges[random() % edgeCount];
+        switch (random() % 4)
+        {
+          case 0: *position[axis] = edge; break;
+          case 1: *position[axis] = edge - 0.01f * unit(); break;
+          default: *position[axis] = 3.0f * unit() - 1.5f; break;
+        }
+        switch (random() % 6)
+        {
+          case 0: *size[axis] = 0.0f; break;
+          case 1: *size[axis] = -0.1f * unit(); break;
+          case 2: *size[axis] = 1e-9f; break;
+          case 3: *size[axis] = edges[random() % edgeCount] - *position[axis]; break;
+          default: *size[axis] = unit(); break;
+        }
+      }
+      colors[i] = random();
+    }
+    
+    const LilVec4& clip = clips[t % (sizeof(clips) / sizeof(clips[0]))];
+    const LilDrawListFlags flags = modes[t / 4 % 3];
+    for (LilDrawList* drawList : { &single, &batched })
+    {
+      drawList->Clear();
+      drawList->Flags = flags;
+      drawList->PushClipRect(LilVec2(clip.x, clip.y), LilVec2(clip.z, clip.w));
+      if (drawList == &single)
+      {
+        for (std::size_t i = 0; i < count; ++i)
+          drawList->PushRect(LilVec2(xs[i], ys[i]), LilVec2(xs[i] + ws[i], ys[i] + hs[i]), colors[i]);
+      }
+      else
+      {
+        drawList->PushRects(&xs[0], &ys[0], &ws[0], &hs[0], &colors[0], count);
+      }
+      drawList->PopClipRect();
+      drawList->Render();
+    }
+    
+    if (SameBytes(single.VtxArray, batched.VtxArray) && SameBytes(single.IdxArray, batched.IdxArray) &&
+        SameBytes(single.RectArray, batched.RectArray) && SameBytes(single.DrawCmds, batched.DrawCmds) &&
+        single.CulledPrims == batched.CulledPrims)
+      continue;
+    
+    std::fprintf(stderr, "push_rects check failed: trial %d, %s, %zu rects, clip %zu\n", t, GetFlagsName(flags), count, static_cast<std::size_t>(t % 4));
+    return false;
+  }
+  
+  return true;
+}
+
+// A table of static cell labels drawn every frame through the context, either laid out again each
+// time (PushText) or through the text layout cache (Lil::Text). Primitives are labels; the cached
+// variant adds how many labels the last frame had to lay out.
+static void BenchTextLayout(const char* variant, bool cached, int rows, int columns, int iterations)
+{
+  const int count = rows * columns;
+  constexpr std::size_t labelSize = 32; // "R%d C%d" of any two ints, so snprintf never truncates
+  LilArray<char> labels;
+  labels.Resize(static_cast<std::size_t>(count) * labelSize);
+  for (int i = 0; i < count; ++i)
+    std::snprintf(&labels[static_cast<std::size_t>(i) * labelSize], labelSize, "R%d C%d", i / columns, i % columns);
+
+  const float cellWidth = 2.0f / columns, cellHeight = 2.0f / rows;
+  const float size = cellHeight * 0.8f;
+  LilFont& font = Lil::GetContext().ActiveFont;
+  const float scale = size / font.LineHeight;
+
+  LilBenchTimer timer;
+  timer.Run(iterations, [&]() {
+    Lil::BeginFrame();
+    for (int i = 0; i < count; ++i)
+    {
+      const char* label = &labels[static_cast<std::size_t>(i) * labelSize];
+      const float x = -1.0f + (i % columns) * cellWidth, y = 1.0f - (i / columns) * cellHeight;
+      if (cached)
+        Lil::Text(x, y, label, size);
+      else
+        Lil::GetDrawList().PushText(font, LilVec2(x, y), LilVec2(scale, scale), label);
+    }
+    Lil::RenderFrame();
+  });
+
+  Report("text_layout", variant, static_cast<std::size_t>(count), timer.BestMs, 0.0, timer.AllocsPerIter(),
+         cached ? "layout_misses" : nullptr, static_cast<double>(Lil::GetFrameStats().TextLayoutMisses));
+}
+
+// Appends codepoints as 3 byte UTF-8 sequences
+static void AppendUTF8(LilArray<char>& text, LilU32 codepoint)
+{
+  text.PushBack(static_cast<char>(0xe0 | (codepoint >> 12)));
+  text.PushBack(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+  text.PushBack(static_cast<char>(0x80 | (codepoint & 0x3f)));
+}
+
+// Cached labels while the glyph cache churns: 2000 ASCII and 200 CJK labels drawn every frame, plus
+// 10 labels per frame that cycle through about five times more CJK glyphs than the cache holds, so
+// shelves are evicted every frame. Primitives are labels, the extra metric is the share of the last
+// frame's labels that came from the layout cache; only the cycling labels should miss.
+static void BenchTextLayoutChurn(int iterations)
+{
+  const int asciiLabels = 2000, cjkLabels = 200, churnLabels = 10, churnCycle = 400;
+  LilArray<char> labels;
+  LilArray<std::size_t> offsets;
+  for (int i = 0; i < asciiLabels; ++i)
+  {
+    char label[16];
+    std::snprintf(label, sizeof(label), "R%d C%d", i / 20, i % 20);
+    offsets.PushBack(labels.GetSize());
+    for (const char* c = label; *c; ++c)
+      labels.PushBack(*c);
+    labels.PushBack('\0');
+  }
+  
+  // Static labels share 400 glyphs, the cycling ones have 8 glyphs of their own each
+  for (int i = 0; i < cjkLabels + churnCycle; ++i)
+  {
+    offsets.PushBack(labels.GetSize());
+    for (int j = 0; j < (i < cjkLabels ? 4 : 8); ++j)
+      AppendUTF8(labels, i < cjkLabels ? 0x4e00 + static_cast<LilU32>((i * 2 + j) % 400) : 0x5000 + static_cast<LilU32>((i - cjkLabels) * 8 + j));
+    labels.PushBack('\0');
+  }
+  
+  LilFont& font = Lil::GetContext().ActiveFont;
+  font.EnableGlyphCache(BenchGlyphSource, nullptr, 512, 256);
+  const std::size_t evictions = font.Cache.Evictions;
+  const float size = 0.02f;
+  int frame = 0;
+  
+  LilBenchTimer timer;
+  timer.Run(iterations, [&]() {
+    Lil::BeginFrame();
+    for (int i = 0; i < asciiLabels + cjkLabels; ++i)
+      Lil::Text(-1.0f + (i % 20) * 0.1f, 1.0f - (i / 20) * 0.02f, &labels[offsets[i]], size);
+    for (int i = 0; i < churnLabels; ++i)
+      Lil::Text(-1.0f + i * 0.2f, -0.9f, &labels[offsets[asciiLabels + cjkLabels + (frame * churnLabels + i) % churnCycle]], size);
+    Lil::RenderFrame();
+    ++frame;
+  });
+  
+  const std::size_t count = asciiLabels + cjkLabels + churnLabels;
+  const double hitRate = 1.0 - static_cast<double>(Lil::GetFrameStats().TextLayoutMisses) / count;
+  if (font.Cache.Evictions == evictions)
+    std::fprintf(stderr, "text_layout churn: the glyph cache never evicted a shelf\n");
+  Report("text_layout", "cached_glyph_churn", count, timer.BestMs, 0.0, timer.AllocsPerIter(), "hit_rate", hitRate);
+}
+
+int main(int argc, char** argv)
+{
+  for (int i = 1; i < argc; ++i)
+    s_Json = s_Json || std::strcmp(argv[i], "--json") == 0;
+
+  // 0) Self-checks, a mismatch fails the run instead of reporting numbers
+  if (!CheckDecodeUTF8() || !CheckPushRects())
+    return 1;
+  
+  if (!s_Json)
+    std::printf("%-16s %-22s %9s %12s %14s %16s\n", "bench", "variant", "prims", "ns/prim", "bytes/prim", "allocs/iter");
+
+  // 1) LilArray growth for multi-megabyte vertex arrays, and push throughput without growth
+  const std::size_t sizes[] = { 1 << 16, 1 << 20, 1 << 22 };
+  for (std::size_t count : sizes)
+  {
+    BenchArrayGrowth<LilBenchVtx>("element_wise", count, 5);
+    BenchArrayGrowth<LilVtx>("relocatable", count, 5);
+  }
+  BenchArrayPush(1 << 20, 10);
+
+  // 2) Rect emission for each primitive stream, one rect at a time and batched
+  const LilDrawListFlags modes[] = { LilDrawListFlags_None, LilDrawListFlags_QuadIndexing, LilDrawListFlags_RectInstancing };
+  LilBenchRects emissionRects(100000);
+  for (LilDrawListFlags flags : modes)
+    BenchRectEmission(emissionRects, flags, 10);
+  for (LilDrawListFlags flags : modes)
+    BenchRectBatch(emissionRects, flags, 10);
+
+  // 3) Font atlas build, text emission, the glyph cache and UTF-8 decoding
+  BenchFontAtlas(50);
+  LilFont font;
+  font.BuildDefault();
+  for (LilDrawListFlags flags : modes)
+    BenchTextEmission(font, flags, 10);
+  BenchGlyphCache("warm", 2000, 1024, 512, 10);
+  BenchGlyphCache("churn", 2000, 512, 256, 10);
+  BenchDecodeUTF8("scalar_ascii", false, false, 10);
+  BenchDecodeUTF8("batched_ascii", true, false, 10);
+  BenchDecodeUTF8("scalar_mixed", false, true, 10);
+  BenchDecodeUTF8("batched_mixed", true, true, 10);
+  
+  // 4) Full frames through the context at 1k, 10k and 100k rects
+  Lil::CreateContext();
+  const int frameSizes[] = { 1000, 10000, 100000 };
+  for (int count : frameSizes)
+  {
+    LilBenchRects rects(count);
+    for (LilDrawListFlags flags : modes)
+      BenchFrame(rects, flags, count >= 100000 ? 10 : 50);
+  }
+  
+  // 5) A 100k rect frame split into 32 panels, recorded on one thread and on several
+  LilBenchRects panelRects(102400);
+  Lil::GetDrawLists()[0].Flags = LilDrawListFlags_None;
+  const int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+  BenchPanelFrame(panelRects, 32, 1, 10);
+  if (hardwareThreads > 1)
+    BenchPanelFrame(panelRects, 32, hardwareThreads < 8 ? hardwareThreads : 8, 10);
+  
+  // 6) 20k static table labels per frame, laid out every frame and through the layout cache
+  BenchTextLayout("relayout", false, 200, 100, 10);
+  BenchTextLayout("cached", true, 200, 100, 10);
+  BenchTextLayoutChurn(10);
+  Lil::DestroyContext();
+
+#ifdef LIL_PROFILE
+  Lil::WriteChromeTrace("lilBench.trace.json");
+#endif
+
+  return 0;
+}
@@ -1,3 +1,9 @@
+newoption
+{
+  trigger = "profile",
+  description = "Compile in the LIL_PROFILE_SCOPE zones (Chrome trace export)"
+}
+
 workspace "lilGUI"
   location "build"
   architecture "x86_64"
@@ -18,6 +24,11 @@ workspace "lilGUI"
     "MultiProcessorCompile"
   }
 
+  filter "options:profile"
+    defines "LIL_PROFILE"
+
+  filter {}
+
 project "lilGUI"
   location "build"
   kind "StaticLib"
@@ -59,6 +70,11 @@ project "lilTest"
     "test/**.h"
   }
 
+  removefiles
+  {
+    "test/lilHeadless.cpp"
+  }
+
   links
   {
     "lilGUI"
@@ -96,3 +112,97 @@ project "lilTest"
       "glfw3",
       "glad"
     }
+
+project "lilBench"
+  location "build"
+  kind "ConsoleApp"
+
+  targetdir "build/lilBench/bin"
+  objdir "build/lilBench/bin-obj"
+
+  files
+  {
+    "bench/**.cpp",
+    "bench/**.h"
+  }
+
+  links
+  {
+    "lilGUI"
+  }
+
+  sysincludedirs
+  {
+    "src"
+  }
+
+  filter "configurations:Debug"
+    runtime "Debug"
+    defines "LIL_DEBUG"
+    symbols "On"
+
+  filter "configurations:Release"
+    runtime "Release"
+    defines "LIL_RELEASE"
+    optimize "On"
+
+  filter "configurations:Dist"
+    runtime "Release"  
+    defines "LIL_DIST"
+    optimize "Full"
+
+  -- std::thread (panel frames) needs libpthread with older glibc
+  filter "system:linux"
+    links
+    {
+      "pthread"
+    }
+
+  filter {}
+
+-- EGL (surfaceless) runs without a window, which only Linux offers here
+if os.istarget("linux") then
+  project "lilHeadless"
+    location "build"
+    kind "ConsoleApp"
+
+    targetdir "build/lilHeadless/bin"
+    objdir "build/lilHeadless/bin-obj"
+
+    files
+    {
+      "test/lilHeadless.cpp",
+      "test/lilRenderer.cpp",
+      "test/lilRenderer.h",
+      "thirdparty/glad/glad.c"
+    }
+
+    links
+    {
+      "lilGUI",
+      "EGL",
+      "dl",
+      "pthread"
+    }
+
+    sysincludedirs
+    {
+      "src",
+      "includes"
+    }
+
+    filter "configurations:Debug"
+      runtime "Debug"
+      defines "LIL_DEBUG"
+      symbols "On"
+
+    filter "configurations:Release"
+      runtime "Release"
+      defines "LIL_RELEASE"
+      optimize "On"
+
+    filter "configurations:Dist"
+      runtime "Release"  
+      defines "LIL_DIST"
+      optimize "Full"
+end
@@ -2,6 +2,299 @@
 
 #include <utility>
 #include <new>
+#include <type_traits>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <atomic>
+
+/*
+--------------------------------------------------
+----- SECTION (LilAllocators) --------------------
+--------------------------------------------------
+ 
+Allocators are stateless policies that LilArray uses for
+its storage. LilHeapAllocator is the default and simply
+wraps malloc/realloc/free, counting every call so benchmarks
+and frame stats can tell how often the heap is touched. The
+counters are atomic (relaxed), since draw lists may grow on
+worker threads.
+ 
+LilArena is a linear (bump) allocator made of chained
+blocks. Freeing or growing the most recent allocation is
+done in place; everything else is reclaimed all at once by
+Reset(), which also merges the blocks into a single one so
+a steady-state frame only ever touches one block.
+ 
+LilFrameAllocator allocates from the calling thread's frame
+arena, so draw lists recorded on worker threads never share
+one. Lil::BeginFrame starts a new frame and every thread's
+arena is reset the first time that thread uses it in the new
+frame. Containers using it must only hold data for one frame
+and must release their storage (Clear, not Shrink) before
+the next Lil::BeginFrame, since the reset invalidates it.
+Freeing memory from another thread's arena is a no-op and
+growing it copies into the calling thread's arena.
+ 
+-- TODO --
+1) N/A
+*/
+
+struct LilAllocatorStats
+{
+  std::size_t Allocations = 0;
+  std::size_t Reallocations = 0;
+  std::size_t Frees = 0;
+};
+
+struct LilHeapAllocator
+{
+  struct Counters
+  {
+    std::atomic<std::size_t> Allocations{ 0 }, Reallocations{ 0 }, Frees{ 0 };
+  };
+  
+  static Counters& GetCounters()
+  {
+    static Counters s_Counters;
+    return s_Counters;
+  }
+  
+  // Snapshot of the counters
+  static LilAllocatorStats GetStats()
+  {
+    const Counters& counters = GetCounters();
+    LilAllocatorStats stats;
+    stats.Allocations = counters.Allocations.load(std::memory_order_relaxed);
+    stats.Reallocations = counters.Reallocations.load(std::memory_order_relaxed);
+    stats.Frees = counters.Frees.load(std::memory_order_relaxed);
+    return stats;
+  }
+  
+  static void* Allocate(std::size_t bytes)
+  {
+    GetCounters().Allocations.fetch_add(1, std::memory_order_relaxed);
+    void* block = std::malloc(bytes);
+    if (!block && bytes)
+      throw std::bad_alloc();
+    return block;
+  }
+  
+  static void* Reallocate(void* block, std::size_t /*oldBytes*/, std::size_t newBytes)
+  {
+    (block ? GetCounters().Reallocations : GetCounters().Allocations).fetch_add(1, std::memory_order_relaxed);
+    void* tmp = std::realloc(block, newBytes);
+    if (!tmp && newBytes)
+      throw std::bad_alloc();
+    return tmp;
+  }
+  
+  static void Deallocate(void* block, std::size_t /*bytes*/) noexcept
+  {
+    if (block)
+      GetCounters().Frees.fetch_add(1, std::memory_order_relaxed);
+    std::free(block);
+  }
+};
+
+class LilArena
+{
+  struct Block
+  {
+    Block* Prev;
+    std::size_t Capacity;
+    std::size_t Used;
+  };
+  
+  static constexpr std::size_t Alignment = alignof(std::max_align_t);
+  static constexpr std::size_t HeaderSize = (sizeof(Block) + Alignment - 1) & ~(Alignment - 1);
+  
+  Block* Current = nullptr;
+  std::size_t BlockSize;
+  void* Last = nullptr; // Most recent allocation, the only one that can grow or shrink in place
+  std::size_t BlockAllocations = 0;
+  
+public:
+  LilArena(std::size_t blockSize = 64 * 1024) noexcept
+    : BlockSize(blockSize)
+  {
+  }
+  
+  LilArena(const LilArena&) = delete;
+  LilArena& operator=(const LilArena&) = delete;
+  
+  ~LilArena() noexcept
+  {
+    FreeBlocks();
+  }
+  
+  void* Allocate(std::size_t bytes)
+  {
+    bytes = AlignSize(bytes);
+    if (!Current || Current->Used + bytes > Current->Capacity)
+      AddBlock(bytes);
+    
+    Last = Data(Current) + Current->Used;
+    Current->Used += bytes;
+    return Last;
+  }
+  
+  void* Reallocate(void* block, std::size_t oldBytes, std::size_t newBytes)
+  {
+    if (block && block == Last)
+    {
+      std::size_t start = static_cast<char*>(block) - Data(Current);
+      if (start + AlignSize(newBytes) <= Current->Capacity)
+      {
+        Current->Used = start + AlignSize(newBytes);
+        return block;
+      }
+    }
+    
+    void* tmp = Allocate(newBytes);
+    if (block)
+      std::memcpy(tmp, block, oldBytes < newBytes ? oldBytes : newBytes);
+    return tmp;
+  }
+  
+  void Deallocate(void* block, std::size_t /*bytes*/) noexcept
+  {
+    if (block && block == Last)
+    {
+      Current->Used = static_cast<char*>(block) - Data(Current);
+      Last = nullptr;
+    }
+  }
+  
+  // Invalidates every allocation. Blocks from this frame are merged so the next one fits in one.
+  void Reset()
+  {
+    Last = nullptr;
+    if (!Current)
+      return;
+    
+    if (Current->Prev)
+    {
+      std::size_t total = 0;
+      for (Block* block = Current; block; block = block->Prev)
+        total += block->Capacity;
+      
+      FreeBlocks();
+      AddBlock(total);
+    }
+    
+    Current->Used = 0;
+  }
+  
+  std::size_t GetUsed() const noexcept
+  {
+    std::size_t used = 0;
+    for (Block* block = Current; block; block = block->Prev)
+      used += block->Used;
+    return used;
+  }
+  
+  // Blocks taken from the heap since construction; a steady-state frame adds none
+  std::size_t GetBlockAllocations() const noexcept { return BlockAllocations; }
+  
+  std::size_t GetCapacity() const noexcept
+  {
+    std::size_t capacity = 0;
+    for (Block* block = Current; block; block = block->Prev)
+      capacity += block->Capacity;
+    return capacity;
+  }
+  
+private:
+  static std::size_t AlignSize(std::size_t bytes) noexcept { return (bytes + Alignment - 1) & ~(Alignment - 1); }
+  static char* Data(Block* block) noexcept { return reinterpret_cast<char*>(block) + HeaderSize; }
+  
+  void AddBlock(std::size_t minBytes)
+  {
+    std::size_t capacity = minBytes > BlockSize ? minBytes : BlockSize;
+    Block* block = static_cast<Block*>(LilHeapAllocator::Allocate(HeaderSize + capacity));
+    block->Prev = Current;
+    block->Capacity = capacity;
+    block->Used = 0;
+    Current = block;
+    ++BlockAllocations;
+  }
+  
+  void FreeBlocks() noexcept
+  {
+    while (Current)
+    {
+      Block* prev = Current->Prev;
+      LilHeapAllocator::Deallocate(Current, HeaderSize + Current->Capacity);
+      Current = prev;
+    }
+  }
+};
+
+struct LilFrameAllocator
+{
+  struct Counters
+  {
+    std::atomic<unsigned> Frame{ 0 }; // Arenas last used in an older frame are reset on their next use
+    std::atomic<std::size_t> Blocks{ 0 }, Bytes{ 0 }; // Over all threads' arenas
+  };
+  
+  static Counters& GetCounters()
+  {
+    static Counters s_Counters;
+    return s_Counters;
+  }
+  
+  // Called by Lil::BeginFrame once every frame arena container has released its storage
+  static void NewFrame() { GetCounters().Frame.fetch_add(1, std::memory_order_release); }
+  
+  // The calling thread's arena
+  static LilArena& GetArena()
+  {
+    thread_local LilArena s_Arena;
+    thread_local unsigned s_Frame = 0;
+    
+    const unsigned frame = GetCounters().Frame.load(std::memory_order_acquire);
+    if (s_Frame != frame)
+    {
+      const std::size_t blocks = s_Arena.GetBlockAllocations();
+      s_Arena.Reset();
+      CountBlocks(s_Arena, blocks);
+      s_Frame = frame;
+    }
+    return s_Arena;
+  }
+  
+  static void* Allocate(std::size_t bytes)
+  {
+    LilArena& arena = GetArena();
+    const std::size_t blocks = arena.GetBlockAllocations();
+    void* block = arena.Allocate(bytes);
+    CountBlocks(arena, blocks);
+    GetCounters().Bytes.fetch_add(bytes, std::memory_order_relaxed);
+    return block;
+  }
+  
+  static void* Reallocate(void* block, std::size_t oldBytes, std::size_t newBytes)
+  {
+    LilArena& arena = GetArena();
+    const std::size_t blocks = arena.GetBlockAllocations();
+    void* tmp = arena.Reallocate(block, oldBytes, newBytes);
+    CountBlocks(arena, blocks);
+    if (newBytes > oldBytes)
+      GetCounters().Bytes.fetch_add(newBytes - oldBytes, std::memory_order_relaxed);
+    return tmp;
+  }
+  
+  static void Deallocate(void* block, std::size_t bytes) noexcept { GetArena().Deallocate(block, bytes); }
+  
+private:
+  static void CountBlocks(const LilArena& arena, std::size_t before) noexcept
+  {
+    if (arena.GetBlockAllocations() != before)
+      GetCounters().Blocks.fetch_add(arena.GetBlockAllocations() - before, std::memory_order_relaxed);
+  }
+};
 
 /*
 --------------------------------------------------
@@ -13,11 +306,20 @@ use as a replacement for std::vector<T>. It's not strictly
 necessary but some implementations of std::vector<T> are
 very slow so it may benefit performance in some instances.
  
+Trivially copyable types (LilVtx, LilIdx, LilDrawCmd, ...)
+are relocated with Allocator::Reallocate (std::realloc for
+the heap) instead of an element-wise move and destroy, which
+lets large blocks grow in place (or be remapped by the
+allocator) rather than copied.
+ 
+The Allocator parameter picks where storage comes from, e.g.
+LilArray<LilVec4, LilFrameAllocator> for per-frame scratch.
+ 
 -- TODO --
 1) Consider adding macro to use std::vector<T> at compile time. (would require function naming changes)
 */
 
-template <typename T>
+template <typename T, typename Allocator = LilHeapAllocator>
 class LilArray {
   
   std::size_t Size;
@@ -39,9 +341,37 @@ public:
   LilArray(std::size_t size)
     : Size(0), MaxSize(0), Array(nullptr)
   {
-    Array = (T*) operator new(size * sizeof(T));
+    Array = Allocate(size);
     MaxSize = size;
   }
+  
+  LilArray(LilArray&& other) noexcept
+    : Size(other.Size), MaxSize(other.MaxSize), Array(other.Array)
+  {
+    other.Size = 0;
+    other.MaxSize = 0;
+    other.Array = nullptr;
+  }
+  
+  LilArray& operator=(LilArray&& other) noexcept
+  {
+    if (this != &other)
+    {
+      Clear();
+      Size = other.Size;
+      MaxSize = other.MaxSize;
+      Array = other.Array;
+      
+      other.Size = 0;
+      other.MaxSize = 0;
+      other.Array = nullptr;
+    }
+    return *this;
+  }
+  
+  // Copies would share (and double free) the same block
+  LilArray(const LilArray&) = delete;
+  LilArray& operator=(const LilArray&) = delete;
 
   ~LilArray() noexcept
   {
@@ -57,9 +387,9 @@ public:
   
   void Clear() noexcept
   {
-    for (int i = 0; i < Size; ++i)
+    for (std::size_t i = 0; i < Size; ++i)
       Array[i].~T();
-    operator delete(Array, MaxSize * sizeof(T));
+    Deallocate(Array, MaxSize);
    
     Array = nullptr;
     Size = 0;
@@ -70,17 +400,24 @@ public:
   {
     if (size <= MaxSize)
       return;
-      
-    T* tmp = (T*) operator new(size * sizeof(T));
+    
+    if constexpr (Relocatable)
+    {
+      Array = static_cast<T*>(Allocator::Reallocate(Array, MaxSize * sizeof(T), size * sizeof(T)));
+    }
+    else
+    {
+      T* tmp = Allocate(size);
 
-    for (int i = 0; i < Size; ++i)
-      new (&tmp[i]) T(std::move(Array[i]));
+      for (std::size_t i = 0; i < Size; ++i)
+        new (&tmp[i]) T(std::move(Array[i]));
 
-    for (int i = 0; i < Size; ++i)
-      Array[i].~T();
+      for (std::size_t i = 0; i < Size; ++i)
+        Array[i].~T();
 
-    operator delete(Array, MaxSize * sizeof(T));
-    Array = tmp;
+      Deallocate(Array, MaxSize);
+      Array = tmp;
+    }
 
     MaxSize = size;
   }
@@ -91,12 +428,28 @@ public:
     if (size >= Size)
       return;
     
-    for (std::size_t i = Size; i < size; ++i)
+    for (std::size_t i = size; i < Size; ++i)
       Array[i].~T();
     
     Size = size;
   }
   
+  // Default constructs any new elements
+  void Resize(std::size_t size)
+  {
+    if (size <= Size)
+    {
+      Shrink(size);
+      return;
+    }
+    
+    Reserve(size);
+    for (std::size_t i = Size; i < size; ++i)
+      new(&Array[i]) T();
+    
+    Size = size;
+  }
+  
   void PushBack(const T& val)
   {
     if (Size == MaxSize)
@@ -125,6 +478,26 @@ public:
     Size++;
   }
   
+  T& Back() noexcept { return Array[Size - 1]; }
+  const T& Back() const noexcept { return Array[Size - 1]; }
+  
+  // Grows by count elements without constructing them and returns the first one.
+  // The caller must construct every element in place before reading it.
+  T* Append(std::size_t count)
+  {
+    static_assert(std::is_trivially_destructible<T>::value, "Append() skips construction, so T must be trivially destructible");
+    
+    if (Size + count > MaxSize)
+    {
+      std::size_t next = NextSize();
+      Reserve(next > Size + count ? next : Size + count);
+    }
+    
+    T* first = Array + Size;
+    Size += count;
+    return first;
+  }
+  
   void PopBack()
   {
     Size--;
@@ -133,6 +506,8 @@ public:
   
   Iterator begin() { return Array; }
   Iterator end() { return Array + Size; }
+  ConstIterator begin() const { return Array; }
+  ConstIterator end() const { return Array + Size; }
   Iterator rbegin() { return Array + Size; }
   Iterator rend() { return Array; }
   ConstIterator cbegin() const { return Array; }
@@ -141,6 +516,18 @@ public:
   ConstIterator crend() const { return Array; }
   
 private:
+  static constexpr bool Relocatable = std::is_trivially_copyable<T>::value;
+  
+  static T* Allocate(std::size_t count)
+  {
+    return static_cast<T*>(Allocator::Allocate(count * sizeof(T)));
+  }
+  
+  static void Deallocate(T* block, std::size_t count) noexcept
+  {
+    Allocator::Deallocate(block, count * sizeof(T));
+  }
+  
   std::size_t NextSize() noexcept
   {
     return MaxSize ? static_cast<std::size_t>(MaxSize + MaxSize / 2) : 8; // Use geometric growth of 1.5 (close to golden ratio; couldn't be a bad number)
@@ -0,0 +1,1144 @@
+#include "lilGUI.h"
+#include "lilProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIL_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#define LIL_AVX2
+#include <immintrin.h>
+#endif
+
+template <typename T>
+static inline T LilMin(T a, T b) { return a < b ? a : b; }
+
+template <typename T>
+static inline T LilMax(T a, T b) { return a > b ? a : b; }
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilSkylinePacker) ----------
+--------------------------------------------------
+*/
+
+void LilSkylinePacker::Init(int width, int height)
+{
+  Width = width;
+  Height = height;
+  UsedHeight = 0;
+
+  Skyline.Shrink(0);
+  Skyline.PushBack({ 0, 0, width });
+}
+
+int LilSkylinePacker::Fit(std::size_t index, int width, int height) const
+{
+  if (Skyline[index].X + width > Width)
+    return -1;
+
+  // The rect rests on the highest segment it spans
+  int y = 0;
+  for (int remaining = width; remaining > 0; ++index)
+  {
+    y = LilMax(y, Skyline[index].Y);
+    remaining -= Skyline[index].Width;
+  }
+
+  return y + height <= Height ? y : -1;
+}
+
+bool LilSkylinePacker::Pack(int width, int height, int& x, int& y)
+{
+  // Lowest resting place wins, ties go to the narrowest segment to keep wide gaps for wide rects
+  std::size_t best = Skyline.GetSize();
+  int bestY = Height, bestWidth = Width + 1;
+  for (std::size_t i = 0; i < Skyline.GetSize(); ++i)
+  {
+    const int fitY = Fit(i, width, height);
+    if (fitY < 0)
+      continue;
+
+    if (fitY < bestY || (fitY == bestY && Skyline[i].Width < bestWidth))
+    {
+      best = i;
+      bestY = fitY;
+      bestWidth = Skyline[i].Width;
+    }
+  }
+
+  if (best == Skyline.GetSize())
+    return false;
+
+  x = Skyline[best].X;
+  y = bestY;
+  UsedHeight = LilMax(UsedHeight, y + height);
+
+  // Raise the skyline over the rect: trim or drop the segments it now covers
+  Skyline.EmplaceBack();
+  for (std::size_t i = Skyline.GetSize() - 1; i > best; --i)
+    Skyline[i] = Skyline[i - 1];
+  Skyline[best] = { x, y + height, width };
+
+  const int right = x + width;
+  std::size_t next = best + 1;
+  while (next < Skyline.GetSize() && Skyline[next].X < right)
+  {
+    Segment& segment = Skyline[next];
+    const int segmentRight = segment.X + segment.Width;
+    if (segmentRight > right)
+    {
+      segment.Width = segmentRight - right;
+      segment.X = right;
+      break;
+    }
+
+    for (std::size_t i = next; i + 1 < Skyline.GetSize(); ++i)
+      Skyline[i] = Skyline[i + 1];
+    Skyline.PopBack();
+  }
+
+  // Neighbours at the same height become one segment
+  for (std::size_t i = 0; i + 1 < Skyline.GetSize();)
+  {
+    if (Skyline[i].Y != Skyline[i + 1].Y)
+    {
+      ++i;
+      continue;
+    }
+
+    Skyline[i].Width += Skyline[i + 1].Width;
+    for (std::size_t j = i + 1; j + 1 < Skyline.GetSize(); ++j)
+      Skyline[j] = Skyline[j + 1];
+    Skyline.PopBack();
+  }
+
+  return true;
+}
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilFont) -------------------
+--------------------------------------------------
+*/
+
+// Public domain 8x8 font (IBM PC BIOS style) for U+0020..U+007E. One byte per row, top row
+// first, bit 0 is the leftmost pixel.
+static const unsigned char s_DefaultFont[95][8] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+  { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00 }, // !
+  { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // "
+  { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00 }, // #
+  { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00 }, // $
+  { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00 }, // %
+  { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00 }, // &
+  { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '
+  { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00 }, // (
+  { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00 }, // )
+  { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00 }, // *
+  { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00 }, // +
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06 }, // ,
+  { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00 }, // -
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00 }, // .
+  { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00 }, // /
+  { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00 }, // 0
+  { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00 }, // 1
+  { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00 }, // 2
+  { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00 }, // 3
+  { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00 }, // 4
+  { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00 }, // 5
+  { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00 }, // 6
+  { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00 }, // 7
+  { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00 }, // 8
+  { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00 }, // 9
+  { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00 }, // :
+  { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06 }, // ;
+  { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00 }, // <
+  { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00 }, // =
+  { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00 }, // >
+  { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00 }, // ?
+  { 0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00 }, // @
+  { 0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00 }, // A
+  { 0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00 }, // B
+  { 0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00 }, // C
+  { 0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00 }, // D
+  { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00 }, // E
+  { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00 }, // F
+  { 0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00 }, // G
+  { 0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00 }, // H
+  { 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 }, // I
+  { 0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00 }, // J
+  { 0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00 }, // K
+  { 0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00 }, // L
+  { 0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00 }, // M
+  { 0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00 }, // N
+  { 0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00 }, // O
+  { 0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00 }, // P
+  { 0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00 }, // Q
+  { 0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00 }, // R
+  { 0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00 }, // S
+  { 0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 }, // T
+  { 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00 }, // U
+  { 0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 }, // V
+  { 0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00 }, // W
+  { 0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00 }, // X
+  { 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00 }, // Y
+  { 0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00 }, // Z
+  { 0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00 }, // [
+  { 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00 }, // backslash
+  { 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00 }, // ]
+  { 0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00 }, // ^
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF }, // _
+  { 0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 }, // `
+  { 0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00 }, // a
+  { 0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00 }, // b
+  { 0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00 }, // c
+  { 0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00 }, // d
+  { 0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00 }, // e
+  { 0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00 }, // f
+  { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F }, // g
+  { 0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00 }, // h
+  { 0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 }, // i
+  { 0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E }, // j
+  { 0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00 }, // k
+  { 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 }, // l
+  { 0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00 }, // m
+  { 0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00 }, // n
+  { 0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00 }, // o
+  { 0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F }, // p
+  { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78 }, // q
+  { 0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00 }, // r
+  { 0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00 }, // s
+  { 0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00 }, // t
+  { 0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00 }, // u
+  { 0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 }, // v
+  { 0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00 }, // w
+  { 0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00 }, // x
+  { 0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F }, // y
+  { 0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00 }, // z
+  { 0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00 }, // {
+  { 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00 }, // |
+  { 0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00 }, // }
+  { 0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ~
+};
+
+static constexpr std::size_t s_DecodeBatchSize = 256; // Codepoints decoded at a time by the text loops
+static constexpr int s_GlyphPadding = 1; // Empty texels between glyphs so filtering never picks up a neighbour
+
+static double GetTimeMs()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool LilFont::Build(const LilGlyphBitmap* glyphs, std::size_t count, float lineHeight)
+{
+  LIL_PROFILE_SCOPE("LilFont::Build");
+
+  const double start = GetTimeMs();
+  AtlasScale = 1.0f;
+  DistanceRange = 0.0f;
+  const bool built = BuildAtlas(glyphs, count, lineHeight);
+  BuildMs = GetTimeMs() - start;
+  return built;
+}
+
+// Packs bitmaps that are already in the atlas format; their sizes are in texels, offsets in font pixels
+bool LilFont::BuildAtlas(const LilGlyphBitmap* glyphs, std::size_t count, float lineHeight)
+{
+  if (!count)
+    return false;
+
+  // Tallest first keeps the skyline flat, which is where most of the packing density comes from
+  LilArray<std::size_t> order;
+  order.Resize(count);
+  std::size_t area = 0;
+  LilU32 firstCodepoint = glyphs[0].Codepoint, lastCodepoint = glyphs[0].Codepoint;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    order[i] = i;
+    area += static_cast<std::size_t>(glyphs[i].Width + s_GlyphPadding) * (glyphs[i].Height + s_GlyphPadding);
+    firstCodepoint = LilMin(firstCodepoint, glyphs[i].Codepoint);
+    lastCodepoint = LilMax(lastCodepoint, glyphs[i].Codepoint);
+  }
+  std::sort(order.begin(), order.end(), [glyphs](std::size_t a, std::size_t b) { return glyphs[a].Height > glyphs[b].Height; });
+
+  // Square-ish power of two width; the height only grows when packing fails
+  int width = 64;
+  while (static_cast<std::size_t>(width) * width < area)
+    width *= 2;
+
+  LilArray<int> positions;
+  positions.Resize(count * 2);
+  LilSkylinePacker packer;
+  for (int height = width;; height *= 2)
+  {
+    packer.Init(width, height);
+
+    bool packed = true;
+    for (std::size_t i = 0; i < count && packed; ++i)
+    {
+      const LilGlyphBitmap& glyph = glyphs[order[i]];
+      if (glyph.Width <= 0 || glyph.Height <= 0)
+        continue;
+      packed = packer.Pack(glyph.Width + s_GlyphPadding, glyph.Height + s_GlyphPadding, positions[order[i] * 2], positions[order[i] * 2 + 1]);
+    }
+
+    if (packed)
+      break;
+    if (height >= 16384)
+      return false;
+  }
+
+  // The atlas is cut down to the rows actually used, plus the glyph cache rows under them
+  const int staticHeight = LilMax(packer.GetUsedHeight(), 1);
+  AtlasWidth = LilMax(width, Cache.Width);
+  AtlasHeight = staticHeight + Cache.Height;
+  AtlasPixels.Resize(static_cast<std::size_t>(AtlasWidth) * AtlasHeight);
+  std::memset(&AtlasPixels[0], 0, AtlasPixels.GetSize());
+
+  FirstCodepoint = firstCodepoint;
+  Glyphs.Shrink(0);
+  Glyphs.Resize(lastCodepoint - firstCodepoint + 1);
+  LineHeight = lineHeight;
+
+  std::size_t glyphArea = 0;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const LilGlyphBitmap& bitmap = glyphs[i];
+    LilGlyph& glyph = Glyphs[bitmap.Codepoint - firstCodepoint];
+    glyph.Codepoint = bitmap.Codepoint;
+    glyph.AdvanceX = bitmap.AdvanceX;
+    if (bitmap.Width <= 0 || bitmap.Height <= 0)
+      continue;
+
+    const int x = positions[i * 2], y = positions[i * 2 + 1];
+    for (int row = 0; row < bitmap.Height; ++row)
+      std::memcpy(&AtlasPixels[static_cast<std::size_t>(y + row) * AtlasWidth + x], bitmap.Pixels + static_cast<std::size_t>(row) * bitmap.Width, bitmap.Width);
+
+    glyph.X0 = bitmap.OffsetX;
+    glyph.Y0 = bitmap.OffsetY;
+    glyph.X1 = bitmap.OffsetX + bitmap.Width / AtlasScale;
+    glyph.Y1 = bitmap.OffsetY + bitmap.Height / AtlasScale;
+    glyph.U0 = static_cast<float>(x) / AtlasWidth;
+    glyph.V0 = static_cast<float>(y) / AtlasHeight;
+    glyph.U1 = static_cast<float>(x + bitmap.Width) / AtlasWidth;
+    glyph.V1 = static_cast<float>(y + bitmap.Height) / AtlasHeight;
+    glyphArea += static_cast<std::size_t>(bitmap.Width) * bitmap.Height;
+  }
+
+  const LilU32 fallback = '?' - firstCodepoint;
+  FallbackGlyph = fallback < Glyphs.GetSize() && Glyphs[fallback].Codepoint == '?' ? fallback : static_cast<LilU32>(glyphs[0].Codepoint - firstCodepoint);
+
+  // Measured over the packed region, a wider glyph cache doesn't count against it
+  PackingDensity = static_cast<float>(glyphArea) / (static_cast<float>(width) * staticHeight);
+  AtlasDirty = true;
+
+  Cache.Top = staticHeight;
+  ResetGlyphCache();
+  return true;
+}
+
+// Glyphs are cropped to their ink so the packer doesn't waste texels on the empty cell borders
+static void GetDefaultGlyphs(unsigned char (*pixels)[64], LilGlyphBitmap* glyphs)
+{
+  for (int i = 0; i < 95; ++i)
+  {
+    int minX = 8, minY = 8, maxX = -1, maxY = -1;
+    for (int y = 0; y < 8; ++y)
+    {
+      for (int x = 0; x < 8; ++x)
+      {
+        if (!(s_DefaultFont[i][y] >> x & 1))
+          continue;
+        minX = LilMin(minX, x);
+        minY = LilMin(minY, y);
+        maxX = LilMax(maxX, x);
+        maxY = LilMax(maxY, y);
+      }
+    }
+
+    LilGlyphBitmap& glyph = glyphs[i];
+    glyph.Codepoint = static_cast<LilU32>(' ' + i);
+    glyph.Width = maxX >= minX ? maxX - minX + 1 : 0;
+    glyph.Height = maxY >= minY ? maxY - minY + 1 : 0;
+    glyph.OffsetX = static_cast<float>(glyph.Width ? minX : 0);
+    glyph.OffsetY = static_cast<float>(glyph.Height ? minY : 0);
+    glyph.AdvanceX = 8.0f;
+    glyph.Pixels = pixels[i];
+
+    for (int y = 0; y < glyph.Height; ++y)
+      for (int x = 0; x < glyph.Width; ++x)
+        pixels[i][y * glyph.Width + x] = (s_DefaultFont[i][minY + y] >> (minX + x) & 1) ? 0xff : 0x00;
+  }
+}
+
+bool LilFont::BuildDefault()
+{
+  unsigned char pixels[95][64];
+  LilGlyphBitmap glyphs[95];
+  GetDefaultGlyphs(pixels, glyphs);
+  return Build(glyphs, 95, 8.0f);
+}
+
+LilVec2 LilFont::CalcTextSize(const char* text, const char* textEnd)
+{
+  if (!textEnd)
+    textEnd = text + std::strlen(text);
+
+  float width = 0.0f, lineWidth = 0.0f;
+  int lines = 1;
+  LilU32 codepoints[s_DecodeBatchSize];
+  while (text < textEnd)
+  {
+    const std::size_t count = Lil::DecodeUTF8(text, textEnd, codepoints, s_DecodeBatchSize);
+    for (std::size_t c = 0; c < count; ++c)
+    {
+      const LilU32 codepoint = codepoints[c];
+      if (codepoint == '\n')
+      {
+        width = LilMax(width, lineWidth);
+        lineWidth = 0.0f;
+        ++lines;
+        continue;
+      }
+
+      lineWidth += GetGlyph(codepoint).AdvanceX;
+    }
+  }
+
+  return LilVec2(LilMax(width, lineWidth), lines * LineHeight);
+}
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilDistanceField) ----------
+--------------------------------------------------
+*/
+
+static constexpr float s_FarAway = 1e20f; // Squared distance of texels with nothing to measure to yet
+static constexpr int s_MaxBuildThreads = 16;
+
+// Exact squared Euclidean distance transform of one row or column (Felzenszwalb and Huttenlocher):
+// the lower envelope of the parabolas rooted at every sample, evaluated at every sample
+static void TransformLine(float* values, int count, int stride, LilDistanceFieldScratch& scratch)
+{
+  float* line = scratch.Line.begin();
+  float* envelope = scratch.Envelope.begin();
+  int* parabolas = scratch.Parabolas.begin();
+  for (int i = 0; i < count; ++i)
+    line[i] = values[i * stride];
+
+  int k = 0;
+  parabolas[0] = 0;
+  envelope[0] = -s_FarAway;
+  envelope[1] = s_FarAway;
+  for (int q = 1; q < count; ++q)
+  {
+    float s;
+    for (;;)
+    {
+      const int p = parabolas[k];
+      s = ((line[q] + static_cast<float>(q * q)) - (line[p] + static_cast<float>(p * p))) / static_cast<float>(2 * (q - p));
+      if (s > envelope[k] || k == 0)
+        break;
+      --k;
+    }
+
+    ++k;
+    parabolas[k] = q;
+    envelope[k] = s;
+    envelope[k + 1] = s_FarAway;
+  }
+
+  k = 0;
+  for (int q = 0; q < count; ++q)
+  {
+    while (envelope[k + 1] < static_cast<float>(q))
+      ++k;
+    const int p = parabolas[k];
+    values[q * stride] = static_cast<float>((q - p) * (q - p)) + line[p];
+  }
+}
+
+static void TransformGrid(float* values, int width, int height, LilDistanceFieldScratch& scratch)
+{
+  for (int x = 0; x < width; ++x)
+    TransformLine(values + x, height, width, scratch);
+  for (int y = 0; y < height; ++y)
+    TransformLine(values + static_cast<std::size_t>(y) * width, width, 1, scratch);
+}
+
+// Scales src up by texelsPerPixel, adds spread texels of border and writes the distance field into
+// pixels. dst (which may be src) gets the field's size in texels and its offset in font pixels.
+static void BuildGlyphDistanceField(const LilGlyphBitmap& src, int texelsPerPixel, int spread, LilArray<unsigned char>& pixels, LilGlyphBitmap& dst, LilDistanceFieldScratch& scratch)
+{
+  const LilGlyphBitmap bitmap = src;
+  if (bitmap.Width <= 0 || bitmap.Height <= 0)
+  {
+    dst = bitmap;
+    return;
+  }
+
+  const int width = bitmap.Width * texelsPerPixel + 2 * spread;
+  const int height = bitmap.Height * texelsPerPixel + 2 * spread;
+  const std::size_t texels = static_cast<std::size_t>(width) * height;
+  const std::size_t lineSize = static_cast<std::size_t>(LilMax(width, height));
+  scratch.Outside.Resize(texels);
+  scratch.Inside.Resize(texels);
+  scratch.Line.Resize(lineSize);
+  scratch.Envelope.Resize(lineSize + 1);
+  scratch.Parabolas.Resize(lineSize);
+  pixels.Resize(texels);
+
+  // Texel centers are measured against each other, so a texel's distance to the outline is half a texel less
+  for (int y = 0; y < height; ++y)
+  {
+    const int sy = y - spread;
+    for (int x = 0; x < width; ++x)
+    {
+      const int sx = x - spread;
+      const bool inside = sx >= 0 && sy >= 0 && sx < bitmap.Width * texelsPerPixel && sy < bitmap.Height * texelsPerPixel &&
+                          bitmap.Pixels[static_cast<std::size_t>(sy / texelsPerPixel) * bitmap.Width + sx / texelsPerPixel] >= 128;
+      const std::size_t i = static_cast<std::size_t>(y) * width + x;
+      scratch.Outside[i] = inside ? 0.0f : s_FarAway;
+      scratch.Inside[i] = inside ? s_FarAway : 0.0f;
+    }
+  }
+
+  TransformGrid(scratch.Outside.begin(), width, height, scratch);
+  TransformGrid(scratch.Inside.begin(), width, height, scratch);
+
+  const float scale = 127.5f / spread;
+  for (std::size_t i = 0; i < texels; ++i)
+  {
+    const float distance = scratch.Outside[i] > 0.0f ? std::sqrt(scratch.Outside[i]) - 0.5f : 0.5f - std::sqrt(scratch.Inside[i]);
+    const float value = 127.5f - distance * scale;
+    pixels[i] = static_cast<unsigned char>(value <= 0.0f ? 0.0f : value >= 255.0f ? 255.0f : value + 0.5f);
+  }
+
+  dst = bitmap;
+  dst.Width = width;
+  dst.Height = height;
+  dst.OffsetX = bitmap.OffsetX - static_cast<float>(spread) / texelsPerPixel;
+  dst.OffsetY = bitmap.OffsetY - static_cast<float>(spread) / texelsPerPixel;
+  dst.Pixels = pixels.begin();
+}
+
+bool LilFont::BuildDistanceField(const LilGlyphBitmap* glyphs, std::size_t count, float lineHeight, int texelsPerPixel, int spread, int threads)
+{
+  LIL_PROFILE_SCOPE("LilFont::BuildDistanceField");
+
+  const double start = GetTimeMs();
+  if (!count || texelsPerPixel < 1 || spread < 1)
+    return false;
+
+  // Every glyph gets its own field buffer, so the workers only share the counter handing out glyphs
+  LilArray<LilArray<unsigned char>> fields;
+  LilArray<LilGlyphBitmap> bitmaps;
+  fields.Resize(count);
+  bitmaps.Resize(count);
+
+  std::atomic<std::size_t> nextGlyph{ 0 };
+  auto work = [&]() {
+    LIL_PROFILE_SCOPE("LilFont::BuildGlyphDistanceFields");
+    LilDistanceFieldScratch scratch;
+    for (std::size_t i = nextGlyph.fetch_add(1, std::memory_order_relaxed); i < count; i = nextGlyph.fetch_add(1, std::memory_order_relaxed))
+      BuildGlyphDistanceField(glyphs[i], texelsPerPixel, spread, fields[i], bitmaps[i], scratch);
+  };
+
+  // The calling thread is one of the workers
+  if (threads <= 0)
+    threads = LilMax(static_cast<int>(std::thread::hardware_concurrency()), 1);
+  threads = LilMin(LilMin(threads, s_MaxBuildThreads), static_cast<int>(count));
+
+  std::thread workers[s_MaxBuildThreads];
+  for (int i = 1; i < threads; ++i)
+    workers[i] = std::thread(work);
+  work();
+  for (int i = 1; i < threads; ++i)
+    workers[i].join();
+
+  AtlasScale = static_cast<float>(texelsPerPixel);
+  DistanceRange = static_cast<float>(2 * spread);
+  const bool built = BuildAtlas(bitmaps.begin(), count, lineHeight);
+  BuildMs = GetTimeMs() - start;
+  return built;
+}
+
+bool LilFont::BuildDefaultDistanceField(int texelsPerPixel, int spread, int threads)
+{
+  unsigned char pixels[95][64];
+  LilGlyphBitmap glyphs[95];
+  GetDefaultGlyphs(pixels, glyphs);
+  return BuildDistanceField(glyphs, 95, 8.0f, texelsPerPixel, spread, threads);
+}
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilGlyphCache) -------------
+--------------------------------------------------
+*/
+
+static constexpr LilU32 s_NoShelf = ~0u; // Glyphs without pixels (spaces) live in no shelf
+static constexpr LilU32 s_FullShelf = ~0u - 1; // Fallback handed out because every shelf was in use this frame
+static constexpr std::size_t s_MaxMissingEntries = 4096; // Remembered missing codepoints before they are forgotten again
+
+static std::size_t HashCodepoint(LilU32 codepoint, std::size_t mask)
+{
+  LilU32 hash = codepoint * 0x9e3779b1u;
+  return (hash ^ (hash >> 15)) & mask;
+}
+
+static LilGlyphCache::Entry* FindEntry(LilGlyphCache& cache, LilU32 codepoint)
+{
+  const std::size_t mask = cache.Table.GetSize() - 1;
+  for (std::size_t i = HashCodepoint(codepoint, mask);; i = (i + 1) & mask)
+  {
+    LilGlyphCache::Entry& entry = cache.Table[i];
+    if (entry.Codepoint == codepoint)
+      return &entry;
+    if (entry.Codepoint == LilGlyphCache::EmptyCodepoint)
+      return nullptr;
+  }
+}
+
+static void InsertEntry(LilGlyphCache& cache, LilU32 codepoint, LilU32 slot);
+
+// Rebuilds the table from the entries keep accepts (linear probing has no cheap single delete)
+template <typename Predicate>
+static void RebuildTable(LilGlyphCache& cache, std::size_t size, Predicate keep)
+{
+  LilArray<LilGlyphCache::Entry> entries;
+  entries.Reserve(cache.Entries);
+  for (const LilGlyphCache::Entry& entry : cache.Table)
+    if (entry.Codepoint != LilGlyphCache::EmptyCodepoint && keep(entry))
+      entries.PushBack(entry);
+
+  cache.Table.Shrink(0);
+  cache.Table.Resize(size);
+  for (LilGlyphCache::Entry& entry : cache.Table)
+    entry = { LilGlyphCache::EmptyCodepoint, 0 };
+  cache.Entries = cache.MissingEntries = 0;
+
+  for (const LilGlyphCache::Entry& entry : entries)
+    InsertEntry(cache, entry.Codepoint, entry.Slot);
+}
+
+static void InsertEntry(LilGlyphCache& cache, LilU32 codepoint, LilU32 slot)
+{
+  // Kept at most half full so probes stay short
+  if ((cache.Entries + 1) * 2 > cache.Table.GetSize())
+    RebuildTable(cache, cache.Table.GetSize() * 2, [](const LilGlyphCache::Entry&) { return true; });
+
+  const std::size_t mask = cache.Table.GetSize() - 1;
+  std::size_t i = HashCodepoint(codepoint, mask);
+  while (cache.Table[i].Codepoint != LilGlyphCache::EmptyCodepoint)
+    i = (i + 1) & mask;
+
+  cache.Table[i] = { codepoint, slot };
+  ++cache.Entries;
+  cache.MissingEntries += slot == LilGlyphCache::MissingSlot;
+}
+
+static void EvictShelf(LilGlyphCache& cache, LilU32 shelf)
+{
+  RebuildTable(cache, cache.Table.GetSize(), [&cache, shelf](const LilGlyphCache::Entry& entry) {
+    if (entry.Slot == LilGlyphCache::MissingSlot || cache.Slots[entry.Slot].Shelf != shelf)
+      return true;
+
+    cache.FreeSlots.PushBack(entry.Slot);
+    return false;
+  });
+
+  cache.Shelves[shelf].X = 0;
+  ++cache.Shelves[shelf].Generation;
+  ++cache.Evictions;
+}
+
+// Shelf with room for a (padded) width x height glyph: the tightest open shelf, a new one, or
+// the least recently used one that no draw of this frame refers to. s_NoShelf if there is none.
+static LilU32 AllocateShelf(LilGlyphCache& cache, int atlasWidth, int atlasHeight, int width, int height)
+{
+  if (width > atlasWidth)
+    return s_NoShelf;
+
+  LilU32 best = s_NoShelf;
+  for (LilU32 i = 0; i < cache.Shelves.GetSize(); ++i)
+  {
+    const LilGlyphCache::Shelf& shelf = cache.Shelves[i];
+    if (shelf.Height < height || shelf.Height - height > height / 2 || shelf.X + width > atlasWidth)
+      continue;
+    if (best == s_NoShelf || shelf.Height < cache.Shelves[best].Height)
+      best = i;
+  }
+  if (best != s_NoShelf)
+    return best;
+
+  const int shelfHeight = (height + 3) & ~3;
+  if (cache.NextShelfY + shelfHeight <= atlasHeight)
+  {
+    cache.Shelves.PushBack({ cache.NextShelfY, shelfHeight, 0, atlasWidth, 0, cache.Frame, 0 });
+    cache.NextShelfY += shelfHeight;
+    return static_cast<LilU32>(cache.Shelves.GetSize() - 1);
+  }
+
+  for (LilU32 i = 0; i < cache.Shelves.GetSize(); ++i)
+  {
+    const LilGlyphCache::Shelf& shelf = cache.Shelves[i];
+    if (shelf.Height < height || shelf.LastUsedFrame == cache.Frame)
+      continue;
+    if (best == s_NoShelf || shelf.LastUsedFrame < cache.Shelves[best].LastUsedFrame)
+      best = i;
+  }
+  if (best != s_NoShelf)
+    EvictShelf(cache, best);
+
+  return best;
+}
+
+void LilFont::EnableGlyphCache(LilGlyphSource source, void* userData, int width, int height)
+{
+  Cache.Source = source;
+  Cache.UserData = userData;
+  Cache.Width = width;
+  Cache.Height = height;
+
+  // Prebuilt glyphs keep their texels, only their UVs move with the new atlas size
+  const int atlasWidth = LilMax(AtlasWidth, width);
+  const int atlasHeight = Cache.Top + height;
+  for (LilGlyph& glyph : Glyphs)
+  {
+    glyph.U0 = std::round(glyph.U0 * AtlasWidth) / atlasWidth;
+    glyph.U1 = std::round(glyph.U1 * AtlasWidth) / atlasWidth;
+    glyph.V0 = std::round(glyph.V0 * AtlasHeight) / atlasHeight;
+    glyph.V1 = std::round(glyph.V1 * AtlasHeight) / atlasHeight;
+  }
+
+  LilArray<unsigned char> pixels;
+  pixels.Resize(static_cast<std::size_t>(atlasWidth) * atlasHeight);
+  std::memset(&pixels[0], 0, pixels.GetSize());
+  for (int y = 0; y < Cache.Top; ++y)
+    std::memcpy(&pixels[static_cast<std::size_t>(y) * atlasWidth], &AtlasPixels[static_cast<std::size_t>(y) * AtlasWidth], AtlasWidth);
+
+  AtlasPixels = std::move(pixels);
+  AtlasWidth = atlasWidth;
+  AtlasHeight = atlasHeight;
+  AtlasDirty = true;
+  ResetGlyphCache();
+}
+
+void LilFont::ResetGlyphCache()
+{
+  std::lock_guard<std::mutex> lock(Cache.Lock);
+
+  Cache.Generation.fetch_add(1, std::memory_order_release);
+  Cache.NextShelfY = Cache.Top;
+  Cache.Shelves.Shrink(0);
+  Cache.Slots.Shrink(0);
+  Cache.FreeSlots.Shrink(0);
+  Cache.Entries = Cache.MissingEntries = 0;
+  Cache.Table.Shrink(0);
+  Cache.Table.Resize(256);
+  for (LilGlyphCache::Entry& entry : Cache.Table)
+    entry = { LilGlyphCache::EmptyCodepoint, 0 };
+
+  if (Cache.Height)
+    std::memset(&AtlasPixels[static_cast<std::size_t>(Cache.Top) * AtlasWidth], 0, static_cast<std::size_t>(Cache.Height) * AtlasWidth);
+}
+
+void LilFont::NewFrame()
+{
+  std::lock_guard<std::mutex> lock(Cache.Lock);
+  ++Cache.Frame;
+}
+
+void LilFont::TakeAtlasUpdates(LilArray<LilAtlasRect>& rects)
+{
+  std::lock_guard<std::mutex> lock(Cache.Lock);
+
+  for (LilGlyphCache::Shelf& shelf : Cache.Shelves)
+  {
+    if (shelf.DirtyMinX >= shelf.DirtyMaxX)
+      continue;
+
+    rects.PushBack({ shelf.DirtyMinX, shelf.Y, shelf.DirtyMaxX - shelf.DirtyMinX, shelf.Height });
+    shelf.DirtyMinX = AtlasWidth;
+    shelf.DirtyMaxX = 0;
+  }
+}
+
+LilGlyph LilFont::GetCachedGlyph(LilU32 codepoint, LilShelfRef* shelf)
+{
+  std::lock_guard<std::mutex> lock(Cache.Lock);
+
+  if (const LilGlyphCache::Entry* entry = FindEntry(Cache, codepoint))
+  {
+    if (entry->Slot == LilGlyphCache::MissingSlot)
+      return Glyphs[FallbackGlyph];
+
+    const LilGlyphCache::Slot& slot = Cache.Slots[entry->Slot];
+    if (slot.Shelf != s_NoShelf)
+    {
+      Cache.Shelves[slot.Shelf].LastUsedFrame = Cache.Frame;
+      if (shelf)
+        *shelf = { slot.Shelf, Cache.Shelves[slot.Shelf].Generation };
+    }
+    ++Cache.Hits;
+    return slot.Glyph;
+  }
+
+  ++Cache.Misses;
+  LilGlyphBitmap bitmap = { codepoint, 0, 0, 0.0f, 0.0f, 0.0f, nullptr };
+  if (!Cache.Source(Cache.UserData, codepoint, bitmap))
+  {
+    if (Cache.MissingEntries >= s_MaxMissingEntries)
+      RebuildTable(Cache, Cache.Table.GetSize(), [](const LilGlyphCache::Entry& entry) { return entry.Slot != LilGlyphCache::MissingSlot; });
+    InsertEntry(Cache, codepoint, LilGlyphCache::MissingSlot);
+    return Glyphs[FallbackGlyph];
+  }
+
+  // Distance field fonts store cached glyphs as distance fields too
+  if (DistanceRange > 0.0f)
+    BuildGlyphDistanceField(bitmap, static_cast<int>(AtlasScale), static_cast<int>(DistanceRange) / 2, Cache.FieldPixels, bitmap, Cache.FieldScratch);
+
+  LilGlyphCache::Slot slot;
+  slot.Glyph.Codepoint = codepoint;
+  slot.Glyph.AdvanceX = bitmap.AdvanceX;
+  slot.Shelf = s_NoShelf;
+
+  if (bitmap.Width > 0 && bitmap.Height > 0)
+  {
+    // Every shelf is in use this frame: draw the fallback now and try again next frame.
+    // Layouts made with the fallback are told to retry too.
+    const int width = bitmap.Width + s_GlyphPadding, height = bitmap.Height + s_GlyphPadding;
+    slot.Shelf = AllocateShelf(Cache, AtlasWidth, AtlasHeight, width, height);
+    if (slot.Shelf == s_NoShelf)
+    {
+      if (shelf)
+        shelf->Shelf = s_FullShelf;
+      return Glyphs[FallbackGlyph];
+    }
+
+    // The padding is cleared too, an evicted glyph may have left texels there
+    LilGlyphCache::Shelf& target = Cache.Shelves[slot.Shelf];
+    const int x = target.X, y = target.Y;
+    for (int row = 0; row < height; ++row)
+    {
+      unsigned char* dst = &AtlasPixels[static_cast<std::size_t>(y + row) * AtlasWidth + x];
+      std::memset(dst, 0, width);
+      if (row < bitmap.Height)
+        std::memcpy(dst, bitmap.Pixels + static_cast<std::size_t>(row) * bitmap.Width, bitmap.Width);
+    }
+
+    target.X += width;
+    target.DirtyMinX = LilMin(target.DirtyMinX, x);
+    target.DirtyMaxX = LilMax(target.DirtyMaxX, x + width);
+    target.LastUsedFrame = Cache.Frame;
+
+    LilGlyph& glyph = slot.Glyph;
+    glyph.X0 = bitmap.OffsetX;
+    glyph.Y0 = bitmap.OffsetY;
+    glyph.X1 = bitmap.OffsetX + bitmap.Width / AtlasScale;
+    glyph.Y1 = bitmap.OffsetY + bitmap.Height / AtlasScale;
+    glyph.U0 = static_cast<float>(x) / AtlasWidth;
+    glyph.V0 = static_cast<float>(y) / AtlasHeight;
+    glyph.U1 = static_cast<float>(x + bitmap.Width) / AtlasWidth;
+    glyph.V1 = static_cast<float>(y + bitmap.Height) / AtlasHeight;
+  }
+
+  LilU32 index;
+  if (!Cache.FreeSlots.Empty())
+  {
+    index = Cache.FreeSlots.Back();
+    Cache.FreeSlots.PopBack();
+    Cache.Slots[index] = slot;
+  }
+  else
+  {
+    index = static_cast<LilU32>(Cache.Slots.GetSize());
+    Cache.Slots.PushBack(slot);
+  }
+
+  InsertEntry(Cache, codepoint, index);
+  if (shelf && slot.Shelf != s_NoShelf)
+    *shelf = { slot.Shelf, Cache.Shelves[slot.Shelf].Generation };
+  return slot.Glyph;
+}
+
+namespace Lil
+{
+
+LilU32 DecodeUTF8(const char*& text, const char* textEnd)
+{
+  const unsigned char* s = reinterpret_cast<const unsigned char*>(text);
+  const unsigned char lead = s[0];
+  if (lead < 0x80)
+  {
+    ++text;
+    return lead;
+  }
+
+  // Sequence length and the smallest codepoint it may encode (anything below is overlong)
+  int length;
+  LilU32 codepoint, minimum;
+  if ((lead & 0xe0) == 0xc0)
+    length = 2, codepoint = lead & 0x1f, minimum = 0x80;
+  else if ((lead & 0xf0) == 0xe0)
+    length = 3, codepoint = lead & 0x0f, minimum = 0x800;
+  else if ((lead & 0xf8) == 0xf0)
+    length = 4, codepoint = lead & 0x07, minimum = 0x10000;
+  else
+  {
+    ++text;
+    return 0xfffd;
+  }
+
+  // A broken sequence only consumes its valid prefix, so the next lead byte is decoded normally
+  int i = 1;
+  for (; i < length; ++i)
+  {
+    if (text + i >= textEnd || (s[i] & 0xc0) != 0x80)
+    {
+      text += i;
+      return 0xfffd;
+    }
+    codepoint = (codepoint << 6) | (s[i] & 0x3f);
+  }
+
+  text += length;
+  if (codepoint < minimum || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff))
+    return 0xfffd;
+  return codepoint;
+}
+
+std::size_t DecodeUTF8(const char*& text, const char* textEnd, LilU32* codepoints, std::size_t capacity)
+{
+  const unsigned char* src = reinterpret_cast<const unsigned char*>(text);
+  const unsigned char* end = reinterpret_cast<const unsigned char*>(textEnd);
+  std::size_t count = 0;
+
+  while (count < capacity && src < end)
+  {
+    // A block is ASCII when no byte has its top bit set; the first block that isn't falls
+    // through to the scalar code, which takes its ASCII prefix and the multibyte sequence
+#ifdef LIL_AVX2
+    while (end - src >= 32 && capacity - count >= 32)
+    {
+      const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+      if (_mm256_movemask_epi8(bytes))
+        break;
+
+      __m256i* dst = reinterpret_cast<__m256i*>(codepoints + count);
+      _mm256_storeu_si256(dst + 0, _mm256_cvtepu8_epi32(_mm256_castsi256_si128(bytes)));
+      _mm256_storeu_si256(dst + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(_mm256_castsi256_si128(bytes), 8)));
+      _mm256_storeu_si256(dst + 2, _mm256_cvtepu8_epi32(_mm256_extracti128_si256(bytes, 1)));
+      _mm256_storeu_si256(dst + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(_mm256_extracti128_si256(bytes, 1), 8)));
+      src += 32;
+      count += 32;
+    }
+#endif
+#ifdef LIL_SSE2
+    while (end - src >= 16 && capacity - count >= 16)
+    {
+      const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      if (_mm_movemask_epi8(bytes))
+        break;
+
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i lo = _mm_unpacklo_epi8(bytes, zero), hi = _mm_unpackhi_epi8(bytes, zero);
+      __m128i* dst = reinterpret_cast<__m128i*>(codepoints + count);
+      _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+      src += 16;
+      count += 16;
+    }
+#endif
+
+    // Up to and including the next multibyte sequence, then back to the blocks
+    while (count < capacity && src < end)
+    {
+      if (*src < 0x80)
+      {
+        codepoints[count++] = *src++;
+        continue;
+      }
+
+      const char* next = reinterpret_cast<const char*>(src);
+      codepoints[count++] = DecodeUTF8(next, textEnd);
+      src = reinterpret_cast<const unsigned char*>(next);
+      break;
+    }
+  }
+
+  text = reinterpret_cast<const char*>(src);
+  return count;
+}
+
+} // namespace Lil
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilTextLayout) -------------
+--------------------------------------------------
+*/
+
+void LilFont::LayoutText(const char* text, const char* textEnd, const LilVec2& scale, float wrapWidth, LilTextLayout& layout)
+{
+  if (!textEnd)
+    textEnd = text + std::strlen(text);
+
+  layout.Quads.Shrink(0);
+  layout.Shelves.Shrink(0);
+  layout.Generation = Cache.Generation.load(std::memory_order_acquire);
+  layout.Incomplete = false;
+
+  // Lines are measured in font pixels, quads are stored in NDC relative to the top-left corner
+  const float wrap = wrapWidth > 0.0f ? wrapWidth / scale.x : 0.0f;
+  float penX = 0.0f, penY = 0.0f, width = 0.0f;
+  float wordEndX = 0.0f; // Pen before the spaces in front of the current word
+  float breakX = 0.0f; // Pen at the start of the current word
+  std::size_t breakQuad = 0; // First quad of the current word
+  bool canBreak = false, afterSpace = false;
+  int lines = 1;
+
+  LilU32 codepoints[s_DecodeBatchSize];
+  while (text < textEnd)
+  {
+    const std::size_t count = Lil::DecodeUTF8(text, textEnd, codepoints, s_DecodeBatchSize);
+    for (std::size_t c = 0; c < count; ++c)
+    {
+      const LilU32 codepoint = codepoints[c];
+      if (codepoint == '\n')
+      {
+        width = LilMax(width, penX);
+        penX = 0.0f;
+        penY += LineHeight;
+        ++lines;
+        canBreak = afterSpace = false;
+        continue;
+      }
+
+      LilShelfRef shelf = { s_NoShelf, 0 };
+      const LilU32 index = codepoint - FirstCodepoint;
+      LilGlyph glyph;
+      if (index < Glyphs.GetSize() && Glyphs[index].Codepoint == codepoint)
+        glyph = Glyphs[index];
+      else
+        glyph = Cache.Source ? GetCachedGlyph(codepoint, &shelf) : Glyphs[FallbackGlyph];
+
+      if (codepoint == ' ')
+      {
+        if (!afterSpace)
+          wordEndX = penX;
+        afterSpace = true;
+        penX += glyph.AdvanceX;
+        continue;
+      }
+
+      // Spaces at the start of a line are no place to break
+      if (afterSpace)
+      {
+        canBreak = wordEndX > 0.0f;
+        breakX = penX;
+        breakQuad = layout.Quads.GetSize();
+        afterSpace = false;
+      }
+
+      // The glyph would stick out of the line: the current word moves down to a new line, or is
+      // split here when it is the only word on its line
+      if (wrap > 0.0f && penX > 0.0f && penX + glyph.X1 > wrap)
+      {
+        if (canBreak)
+        {
+          width = LilMax(width, wordEndX);
+          const float dx = -breakX * scale.x, dy = -LineHeight * scale.y;
+          for (std::size_t i = breakQuad; i < layout.Quads.GetSize(); ++i)
+          {
+            LilTextQuad& quad = layout.Quads[i];
+            quad.Min = LilVec2(quad.Min.x + dx, quad.Min.y + dy);
+            quad.Max = LilVec2(quad.Max.x + dx, quad.Max.y + dy);
+          }
+          penX -= breakX;
+        }
+        else
+        {
+          width = LilMax(width, penX);
+          penX = 0.0f;
+        }
+
+        penY += LineHeight;
+        ++lines;
+        canBreak = false;
+      }
+
+      if (glyph.X1 > glyph.X0)
+      {
+        // Atlas rows go down, NDC y goes up, so the bottom of the quad samples the glyph's last row
+        LilTextQuad quad;
+        quad.Min = LilVec2((penX + glyph.X0) * scale.x, -(penY + glyph.Y1) * scale.y);
+        quad.Max = LilVec2((penX + glyph.X1) * scale.x, -(penY + glyph.Y0) * scale.y);
+        quad.UVMin = LilVec2(glyph.U0, glyph.V1);
+        quad.UVMax = LilVec2(glyph.U1, glyph.V0);
+        layout.Quads.PushBack(quad);
+      }
+
+      // Glyphs share shelves, so most of them are already in the list
+      if (shelf.Shelf == s_FullShelf)
+        layout.Incomplete = true;
+      else if (shelf.Shelf != s_NoShelf &&
+               std::find_if(layout.Shelves.begin(), layout.Shelves.end(), [&shelf](const LilShelfRef& ref) { return ref.Shelf == shelf.Shelf; }) == layout.Shelves.end())
+        layout.Shelves.PushBack(shelf);
+
+      penX += glyph.AdvanceX;
+    }
+  }
+
+  layout.Size = LilVec2(LilMax(width, penX) * scale.x, lines * LineHeight * scale.y);
+
+  layout.InkMin = layout.InkMax = LilVec2(0.0f, 0.0f);
+  if (!layout.Quads.Empty())
+  {
+    layout.InkMin = layout.Quads[0].Min;
+    layout.InkMax = layout.Quads[0].Max;
+    for (const LilTextQuad& quad : layout.Quads)
+    {
+      layout.InkMin = LilVec2(LilMin(layout.InkMin.x, quad.Min.x), LilMin(layout.InkMin.y, quad.Min.y));
+      layout.InkMax = LilVec2(LilMax(layout.InkMax.x, quad.Max.x), LilMax(layout.InkMax.y, quad.Max.y));
+    }
+  }
+}
+
+bool LilFont::AcquireLayout(const LilTextLayout& layout)
+{
+  if (layout.Incomplete)
+    return false;
+
+  // Prebuilt glyphs only move when the font is rebuilt, which bumps the atlas generation
+  if (layout.Shelves.Empty())
+    return layout.Generation == Cache.Generation.load(std::memory_order_acquire);
+
+  // Checked under the lock, so no shelf can be evicted between the check and being marked as used.
+  // A rebuild drops every shelf, so the atlas generation has to match before the shelves are looked at.
+  std::lock_guard<std::mutex> lock(Cache.Lock);
+  if (layout.Generation != Cache.Generation.load(std::memory_order_relaxed))
+    return false;
+
+  for (const LilShelfRef& ref : layout.Shelves)
+  {
+    if (Cache.Shelves[ref.Shelf].Generation != ref.Generation)
+      return false;
+  }
+
+  for (const LilShelfRef& ref : layout.Shelves)
+    Cache.Shelves[ref.Shelf].LastUsedFrame = Cache.Frame;
+  return true;
+}
@@ -1,4 +1,19 @@
 #include "lilGUI.h"
+#include "lilProfiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIL_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#define LIL_AVX2
+#include <immintrin.h>
+#endif
 
 /*
 --------------------------------------------------
@@ -6,37 +21,897 @@
 --------------------------------------------------
 */
 
+// The last command is always open while recording; closing it fills in its counts
+static void CloseDrawCmd(LilDrawList& drawList)
+{
+  LilDrawCmd& command = drawList.DrawCmds.Back();
+  if (drawList.Flags & LilDrawListFlags_QuadIndexing)
+    command.Size = (static_cast<LilU32>(drawList.VtxArray.GetSize()) - command.VtxOffset) / 4 * 6;
+  else
+    command.Size = static_cast<LilU32>(drawList.IdxArray.GetSize()) - command.IdxOffset;
+  command.InstCount = static_cast<LilU32>(drawList.RectArray.GetSize()) - command.InstOffset;
+}
+
+static bool HasTriangles(const LilDrawList& drawList, const LilDrawCmd& command)
+{
+  if (drawList.Flags & LilDrawListFlags_QuadIndexing)
+    return drawList.VtxArray.GetSize() != command.VtxOffset;
+  return drawList.IdxArray.GetSize() != command.IdxOffset;
+}
+
+static bool HasInstances(const LilDrawList& drawList, const LilDrawCmd& command)
+{
+  return drawList.RectArray.GetSize() != command.InstOffset;
+}
+
+static bool SameClipRect(const LilVec4& a, const LilVec4& b)
+{
+  return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+// Both commands are closed and next directly follows prev
+static bool CanMergeDrawCmds(const LilDrawList& drawList, const LilDrawCmd& prev, const LilDrawCmd& next)
+{
+  if (prev.TextureID != next.TextureID || !SameClipRect(prev.ClipRect, next.ClipRect))
+    return false;
+  
+  if (prev.InstCount || next.InstCount)
+    return prev.Size == 0 && next.Size == 0 && prev.InstOffset + prev.InstCount == next.InstOffset;
+  
+  if (drawList.Flags & LilDrawListFlags_QuadIndexing)
+    return prev.VtxOffset + prev.Size / 6 * 4 == next.VtxOffset && (prev.Size + next.Size) / 6 <= Lil::MaxQuadsPerCmd;
+  
+  return prev.VtxOffset == next.VtxOffset && prev.IdxOffset + prev.Size == next.IdxOffset;
+}
+
+// Clips min/max to the clip rect and moves the UVs along. Returns false when nothing is left.
+static bool ClipRectUV(const LilVec4& clip, LilVec2& min, LilVec2& max, LilVec2& uvMin, LilVec2& uvMax)
+{
+  const LilVec2 clippedMin(min.x > clip.x ? min.x : clip.x, min.y > clip.y ? min.y : clip.y);
+  const LilVec2 clippedMax(max.x < clip.z ? max.x : clip.z, max.y < clip.w ? max.y : clip.w);
+  if (clippedMin.x >= clippedMax.x || clippedMin.y >= clippedMax.y)
+    return false;
+  
+  if (clippedMin.x != min.x || clippedMin.y != min.y || clippedMax.x != max.x || clippedMax.y != max.y)
+  {
+    // Sides that aren't clipped keep their UV exactly. The fraction is divided, not multiplied by a
+    // reciprocal, so a 0..1 range (what PushRects assumes) comes out exactly like PushRects clips it.
+    const float w = max.x - min.x, h = max.y - min.y;
+    const LilVec2 uv0 = uvMin, uv1 = uvMax;
+    uvMin = LilVec2(clippedMin.x != min.x ? uv0.x + (uv1.x - uv0.x) * ((clippedMin.x - min.x) / w) : uv0.x,
+                    clippedMin.y != min.y ? uv0.y + (uv1.y - uv0.y) * ((clippedMin.y - min.y) / h) : uv0.y);
+    uvMax = LilVec2(clippedMax.x != max.x ? uv0.x + (uv1.x - uv0.x) * ((clippedMax.x - min.x) / w) : uv1.x,
+                    clippedMax.y != max.y ? uv0.y + (uv1.y - uv0.y) * ((clippedMax.y - min.y) / h) : uv1.y);
+    min = clippedMin;
+    max = clippedMax;
+  }
+  
+  return true;
+}
+
+static bool ContainsRect(const LilVec4& clip, const LilVec2& min, const LilVec2& max)
+{
+  return min.x >= clip.x && min.y >= clip.y && max.x <= clip.z && max.y <= clip.w;
+}
+
 void LilDrawList::Clear()
 {
   VtxArray.Shrink(0);
   IdxArray.Shrink(0);
+  RectArray.Shrink(0);
   DrawCmds.Shrink(0);
+  TextureStack.Clear();
+  ClipRectStack.Clear();
+  CullRect = Lil::ViewportRect;
+  CulledPrims = 0;
   VtxOffset = 0;
+  
+  DrawCmds.EmplaceBack();
 }
 
 void LilDrawList::Render()
 {
-  // This system will grow more complicated when we support textures and clipping rects
-  DrawCmds.EmplaceBack(static_cast<LilU32>(IdxArray.GetSize()), 0, 0);
+  LIL_PROFILE_SCOPE("LilDrawList::Render");
+  
+  if (DrawCmds.Empty())
+    return;
+  
+  CloseDrawCmd(*this);
+  
+  // State changes already avoid most splits while recording, this catches the rest and drops empty commands
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < DrawCmds.GetSize(); ++i)
+  {
+    const LilDrawCmd& command = DrawCmds[i];
+    if (command.Size == 0 && command.InstCount == 0)
+      continue;
+    
+    if (count && CanMergeDrawCmds(*this, DrawCmds[count - 1], command))
+    {
+      DrawCmds[count - 1].Size += command.Size;
+      DrawCmds[count - 1].InstCount += command.InstCount;
+      continue;
+    }
+    
+    DrawCmds[count++] = command;
+  }
+  DrawCmds.Shrink(count);
+}
+
+void LilDrawList::AddDrawCmd()
+{
+  // Close the current command and rebase the next one on the next vertex
+  CloseDrawCmd(*this);
+  
+  const LilDrawCmd& current = DrawCmds.Back();
+  const LilU32 textureID = current.TextureID;
+  const LilVec4 clipRect = current.ClipRect;
+  DrawCmds.EmplaceBack(0, static_cast<LilU32>(IdxArray.GetSize()), static_cast<LilU32>(VtxArray.GetSize()), static_cast<LilU32>(RectArray.GetSize()), textureID, clipRect);
+  VtxOffset = 0;
+}
+
+void LilDrawList::PushTextureID(LilU32 textureID)
+{
+  TextureStack.PushBack(textureID);
+  SetDrawCmdState(textureID, DrawCmds.Back().ClipRect);
+}
+
+void LilDrawList::PopTextureID()
+{
+  TextureStack.PopBack();
+  if (TextureStack.Empty())
+    TextureStack.Clear();
+  SetDrawCmdState(TextureStack.Empty() ? 0 : TextureStack.Back(), DrawCmds.Back().ClipRect);
+}
+
+void LilDrawList::PushClipRect(const LilVec2& min, const LilVec2& max, bool intersectWithCurrent)
+{
+  LilVec4 clip(min.x, min.y, max.x, max.y);
+  if (intersectWithCurrent)
+  {
+    const LilVec4 current = GetClipRect();
+    clip.x = clip.x > current.x ? clip.x : current.x;
+    clip.y = clip.y > current.y ? clip.y : current.y;
+    clip.z = clip.z < current.z ? clip.z : current.z;
+    clip.w = clip.w < current.w ? clip.w : current.w;
+  }
+  
+  // Commands pick the clip rect up lazily, only rects that no longer fit their command's clip rect need a new one
+  ClipRectStack.PushBack(clip);
+  UpdateCullRect();
+}
+
+void LilDrawList::PopClipRect()
+{
+  ClipRectStack.PopBack();
+  if (ClipRectStack.Empty())
+    ClipRectStack.Clear();
+  UpdateCullRect();
+}
+
+void LilDrawList::UpdateCullRect()
+{
+  const LilVec4 clip = GetClipRect();
+  const LilVec4& viewport = Lil::ViewportRect;
+  CullRect = LilVec4(clip.x > viewport.x ? clip.x : viewport.x,
+                     clip.y > viewport.y ? clip.y : viewport.y,
+                     clip.z < viewport.z ? clip.z : viewport.z,
+                     clip.w < viewport.w ? clip.w : viewport.w);
+}
+
+LilVec4 LilDrawList::GetClipRect() const
+{
+  return ClipRectStack.Empty() ? Lil::NoClipRect : ClipRectStack.Back();
+}
+
+void LilDrawList::SetDrawCmdState(LilU32 textureID, const LilVec4& clipRect)
+{
+  LilDrawCmd& current = DrawCmds.Back();
+  if (current.TextureID == textureID && SameClipRect(current.ClipRect, clipRect))
+    return;
+  
+  // Nothing was recorded with the old state, so the command is retargeted or folded back into the previous one
+  if (!HasTriangles(*this, current) && !HasInstances(*this, current))
+  {
+    const LilDrawCmd* prev = DrawCmds.GetSize() > 1 ? &DrawCmds[DrawCmds.GetSize() - 2] : nullptr;
+    if (prev && prev->TextureID == textureID && SameClipRect(prev->ClipRect, clipRect))
+    {
+      DrawCmds.PopBack();
+      VtxOffset = static_cast<LilU32>(VtxArray.GetSize()) - DrawCmds.Back().VtxOffset;
+      return;
+    }
+    
+    current.TextureID = textureID;
+    current.ClipRect = clipRect;
+    return;
+  }
+  
+  // Indexed commands keep their base vertex so neighbours with the same state can merge in Render.
+  // Quad indexed ones always start at IdxOffset 0, so they rebase (which costs nothing without indices).
+  if (Flags & LilDrawListFlags_QuadIndexing)
+  {
+    AddDrawCmd();
+    DrawCmds.Back().TextureID = textureID;
+    DrawCmds.Back().ClipRect = clipRect;
+    return;
+  }
+  
+  const LilU32 vtxOffset = current.VtxOffset;
+  CloseDrawCmd(*this);
+  DrawCmds.EmplaceBack(0, static_cast<LilU32>(IdxArray.GetSize()), vtxOffset, static_cast<LilU32>(RectArray.GetSize()), textureID, clipRect);
 }
 
 void LilDrawList::PushRect(const LilVec2& min, const LilVec2& max, LilU32 color)
 {
-  VtxArray.EmplaceBack(LilVec3(min.x, min.y, 0.0f), LilVec2(0.0f, 0.0f), color);
-  VtxArray.EmplaceBack(LilVec3(max.x, min.y, 0.0f), LilVec2(1.0f, 0.0f), color);
-  VtxArray.EmplaceBack(LilVec3(max.x, max.y, 0.0f), LilVec2(1.0f, 1.0f), color);
-  VtxArray.EmplaceBack(LilVec3(min.x, max.y, 0.0f), LilVec2(0.0f, 1.0f), color);
+  // Rects are clipped here (to the viewport too) so they can share a command with anything else;
+  // fully clipped ones cost nothing
+  LilVec2 clippedMin = min, clippedMax = max;
+  LilVec2 uvMin(0.0f, 0.0f), uvMax(1.0f, 1.0f);
+  if (!ClipRectUV(CullRect, clippedMin, clippedMax, uvMin, uvMax))
+  {
+    ++CulledPrims;
+    return;
+  }
+  
+  if (!ContainsRect(DrawCmds.Back().ClipRect, clippedMin, clippedMax))
+    SetDrawCmdState(DrawCmds.Back().TextureID, Lil::NoClipRect);
+  
+  if (Flags & LilDrawListFlags_RectInstancing)
+  {
+    WriteRectInstance(clippedMin, clippedMax, uvMin, uvMax, color);
+    return;
+  }
+  
+  ReserveGeometry((Flags & LilDrawListFlags_QuadIndexing) ? 0 : 6, 4);
+  PrimRect(clippedMin, clippedMax, uvMin, uvMax, color);
+}
+
+constexpr std::size_t s_TextBatchSize = 256; // Codepoints decoded and quads emitted at a time, far below the 16-bit limit
+
+void LilDrawList::PushText(LilFont& font, const LilVec2& pos, const LilVec2& scale, const char* text, const char* textEnd, LilU32 color)
+{
+  if (!textEnd)
+    textEnd = text + std::strlen(text);
+  if (text == textEnd || font.Glyphs.Empty())
+    return;
+  
+  // Every glyph is clipped to CullRect, so (like PushRects) one clip check covers the whole string.
+  // The atlas only replaces the texture while the text is recorded, consecutive strings still share a command.
+  const LilU32 textureID = DrawCmds.Back().TextureID;
+  const LilVec4 clipRect = ContainsRect(DrawCmds.Back().ClipRect, LilVec2(CullRect.x, CullRect.y), LilVec2(CullRect.z, CullRect.w)) ? DrawCmds.Back().ClipRect : Lil::NoClipRect;
+  SetDrawCmdState(font.TextureID, clipRect);
+  
+  // The text is decoded a batch at a time and laid out relative to pos, then each batch of quads
+  // is culled, clipped and emitted like a cached layout
+  LilU32 codepoints[s_TextBatchSize];
+  LilTextQuad quads[s_TextBatchSize];
+  const LilGlyph* glyphs = font.Glyphs.begin();
+  const LilU32 glyphCount = static_cast<LilU32>(font.Glyphs.GetSize());
+  float penX = 0.0f, penY = 0.0f;
+  
+  while (text < textEnd)
+  {
+    const std::size_t decoded = Lil::DecodeUTF8(text, textEnd, codepoints, s_TextBatchSize);
+    std::size_t count = 0;
+    LilVec2 inkMin(std::numeric_limits<float>::max()), inkMax(-std::numeric_limits<float>::max());
+    
+    for (std::size_t i = 0; i < decoded; ++i)
+    {
+      const LilU32 codepoint = codepoints[i];
+      if (codepoint == '\n')
+      {
+        penX = 0.0f;
+        penY -= font.LineHeight * scale.y;
+        continue;
+      }
+      
+      // Prebuilt glyphs are read in place, only cached ones are copied out of the cache
+      const LilU32 index = codepoint - font.FirstCodepoint;
+      LilGlyph cached;
+      const LilGlyph* glyph = index < glyphCount ? &glyphs[index] : nullptr;
+      if (!glyph || glyph->Codepoint != codepoint)
+      {
+        cached = font.GetGlyph(codepoint);
+        glyph = &cached;
+      }
+      
+      const float x = penX;
+      penX += glyph->AdvanceX * scale.x;
+      if (glyph->X1 <= glyph->X0)
+        continue;
+      
+      // Atlas rows go down, NDC y goes up, so the bottom of the quad samples the glyph's last row
+      LilTextQuad& quad = quads[count++];
+      quad.Min = LilVec2(x + glyph->X0 * scale.x, penY - glyph->Y1 * scale.y);
+      quad.Max = LilVec2(x + glyph->X1 * scale.x, penY - glyph->Y0 * scale.y);
+      quad.UVMin = LilVec2(glyph->U0, glyph->V1);
+      quad.UVMax = LilVec2(glyph->U1, glyph->V0);
+      inkMin = LilVec2(quad.Min.x < inkMin.x ? quad.Min.x : inkMin.x, quad.Min.y < inkMin.y ? quad.Min.y : inkMin.y);
+      inkMax = LilVec2(quad.Max.x > inkMax.x ? quad.Max.x : inkMax.x, quad.Max.y > inkMax.y ? quad.Max.y : inkMax.y);
+    }
+    
+    PushTextQuads(quads, count, pos, inkMin, inkMax, color);
+  }
+  
+  SetDrawCmdState(textureID, DrawCmds.Back().ClipRect);
+}
+
+void LilDrawList::PushTextLayout(const LilTextLayout& layout, LilU32 textureID, const LilVec2& pos, LilU32 color)
+{
+  if (layout.Quads.Empty())
+    return;
+  
+  // Same state handling as PushText
+  const LilU32 previousTextureID = DrawCmds.Back().TextureID;
+  const LilVec4 clipRect = ContainsRect(DrawCmds.Back().ClipRect, LilVec2(CullRect.x, CullRect.y), LilVec2(CullRect.z, CullRect.w)) ? DrawCmds.Back().ClipRect : Lil::NoClipRect;
+  SetDrawCmdState(textureID, clipRect);
+  
+  PushTextQuads(layout.Quads.begin(), layout.Quads.GetSize(), pos, layout.InkMin, layout.InkMax, color);
+  
+  SetDrawCmdState(previousTextureID, DrawCmds.Back().ClipRect);
+}
+
+void LilDrawList::PushTextQuads(const LilTextQuad* quads, std::size_t count, const LilVec2& pos, const LilVec2& inkMin, const LilVec2& inkMax, LilU32 color)
+{
+  if (count == 0)
+    return;
+  
+  // All quads are culled or accepted at once, only runs crossing CullRect are clipped per glyph
+  const LilVec2 min(pos.x + inkMin.x, pos.y + inkMin.y), max(pos.x + inkMax.x, pos.y + inkMax.y);
+  if (max.x <= CullRect.x || max.y <= CullRect.y || min.x >= CullRect.z || min.y >= CullRect.w)
+  {
+    CulledPrims += static_cast<LilU32>(count);
+    return;
+  }
+  const bool clip = !ContainsRect(CullRect, min, max);
+  
+  const bool instancing = Flags & LilDrawListFlags_RectInstancing;
+  const LilU32 idxPerQuad = (Flags & LilDrawListFlags_QuadIndexing) ? 0 : 6;
+  
+  if (!clip && !instancing)
+  {
+    // Same output as PrimRect, through locals like PushRects
+    for (std::size_t first = 0; first < count; first += s_TextBatchSize)
+    {
+      const std::size_t size = count - first < s_TextBatchSize ? count - first : s_TextBatchSize;
+      ReserveGeometry(idxPerQuad * static_cast<LilU32>(size), 4 * static_cast<LilU32>(size));
+      LilVtx* vtx = VtxWritePtr;
+      LilIdx* idx = IdxWritePtr;
+      LilU32 base = VtxOffset;
+      
+      for (std::size_t i = first; i < first + size; ++i, base += 4, vtx += 4)
+      {
+        const LilTextQuad& quad = quads[i];
+        const float minX = pos.x + quad.Min.x, minY = pos.y + quad.Min.y, maxX = pos.x + quad.Max.x, maxY = pos.y + quad.Max.y;
+        
+        new(vtx + 0) LilVtx(LilVec3(minX, minY, 0.0f), LilVec2(quad.UVMin.x, quad.UVMin.y), color);
+        new(vtx + 1) LilVtx(LilVec3(maxX, minY, 0.0f), LilVec2(quad.UVMax.x, quad.UVMin.y), color);
+        new(vtx + 2) LilVtx(LilVec3(maxX, maxY, 0.0f), LilVec2(quad.UVMax.x, quad.UVMax.y), color);
+        new(vtx + 3) LilVtx(LilVec3(minX, maxY, 0.0f), LilVec2(quad.UVMin.x, quad.UVMax.y), color);
+        
+        if (idxPerQuad)
+        {
+          idx[0] = static_cast<LilIdx>(base);
+          idx[1] = static_cast<LilIdx>(base + 1);
+          idx[2] = static_cast<LilIdx>(base + 2);
+          idx[3] = static_cast<LilIdx>(base);
+          idx[4] = static_cast<LilIdx>(base + 2);
+          idx[5] = static_cast<LilIdx>(base + 3);
+          idx += 6;
+        }
+      }
+      
+      VtxWritePtr = vtx;
+      IdxWritePtr = idx;
+      VtxOffset = base;
+    }
+    return;
+  }
+  
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const LilTextQuad& quad = quads[i];
+    LilVec2 quadMin(pos.x + quad.Min.x, pos.y + quad.Min.y), quadMax(pos.x + quad.Max.x, pos.y + quad.Max.y);
+    LilVec2 uvMin = quad.UVMin, uvMax = quad.UVMax;
+    if (clip && !ClipRectUV(CullRect, quadMin, quadMax, uvMin, uvMax))
+    {
+      ++CulledPrims;
+      continue;
+    }
+    
+    if (instancing)
+    {
+      WriteRectInstance(quadMin, quadMax, uvMin, uvMax, color);
+      continue;
+    }
+    
+    ReserveGeometry(idxPerQuad, 4);
+    PrimRect(quadMin, quadMax, uvMin, uvMax, color);
+  }
+}
+
+void LilDrawList::PrimRectInstance(const LilVec2& min, const LilVec2& max, const LilVec2& uvMin, const LilVec2& uvMax, LilU32 color)
+{
+  if (!IsRectVisible(min, max))
+    return;
   
-  IdxArray.PushBack(VtxOffset);
-  IdxArray.PushBack(VtxOffset + 1);
-  IdxArray.PushBack(VtxOffset + 2);
-  IdxArray.PushBack(VtxOffset);
-  IdxArray.PushBack(VtxOffset + 2);
-  IdxArray.PushBack(VtxOffset + 3);
+  SetDrawCmdState(DrawCmds.Back().TextureID, GetClipRect());
+  WriteRectInstance(min, max, uvMin, uvMax, color);
+}
+
+void LilDrawList::PrimReserve(LilU32 idxCount, LilU32 vtxCount)
+{
+  SetDrawCmdState(DrawCmds.Back().TextureID, GetClipRect());
+  ReserveGeometry(idxCount, vtxCount);
+}
+
+void LilDrawList::WriteRectInstance(const LilVec2& min, const LilVec2& max, const LilVec2& uvMin, const LilVec2& uvMax, LilU32 color)
+{
+  if (HasTriangles(*this, DrawCmds.Back()))
+    AddDrawCmd();
+  
+  RectArray.EmplaceBack(min, max, uvMin, uvMax, color, DrawCmds.Back().TextureID);
+}
+
+void LilDrawList::ReserveGeometry(LilU32 idxCount, LilU32 vtxCount)
+{
+  const std::uint64_t maxVertices = (Flags & LilDrawListFlags_QuadIndexing) ? 4 * Lil::MaxQuadsPerCmd : static_cast<std::uint64_t>(std::numeric_limits<LilIdx>::max()) + 1;
+  
+  if (static_cast<std::uint64_t>(VtxOffset) + vtxCount > maxVertices || HasInstances(*this, DrawCmds.Back()))
+    AddDrawCmd();
+  
+  VtxWritePtr = VtxArray.Append(vtxCount);
+  IdxWritePtr = IdxArray.Append(idxCount);
+}
+
+void LilDrawList::PrimRect(const LilVec2& min, const LilVec2& max, const LilVec2& uvMin, const LilVec2& uvMax, LilU32 color)
+{
+  if (!(Flags & LilDrawListFlags_QuadIndexing))
+  {
+    LilIdx idx = static_cast<LilIdx>(VtxOffset);
+    IdxWritePtr[0] = idx;
+    IdxWritePtr[1] = static_cast<LilIdx>(idx + 1);
+    IdxWritePtr[2] = static_cast<LilIdx>(idx + 2);
+    IdxWritePtr[3] = idx;
+    IdxWritePtr[4] = static_cast<LilIdx>(idx + 2);
+    IdxWritePtr[5] = static_cast<LilIdx>(idx + 3);
+    IdxWritePtr += 6;
+  }
+  
+  new(VtxWritePtr + 0) LilVtx(LilVec3(min.x, min.y, 0.0f), LilVec2(uvMin.x, uvMin.y), color);
+  new(VtxWritePtr + 1) LilVtx(LilVec3(max.x, min.y, 0.0f), LilVec2(uvMax.x, uvMin.y), color);
+  new(VtxWritePtr + 2) LilVtx(LilVec3(max.x, max.y, 0.0f), LilVec2(uvMax.x, uvMax.y), color);
+  new(VtxWritePtr + 3) LilVtx(LilVec3(min.x, max.y, 0.0f), LilVec2(uvMin.x, uvMax.y), color);
+  VtxWritePtr += 4;
   
   VtxOffset += 4;
 }
 
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilDrawList Batches) -------
+--------------------------------------------------
+*/
+
+namespace
+{
+
+constexpr std::size_t s_RectBatchSize = 256; // Rects clipped per reserve, small enough to stay in L1
+
+// Clipped rects of one batch, compacted so only visible ones are left
+struct LilRectBatch
+{
+  alignas(32) float MinX[s_RectBatchSize], MinY[s_RectBatchSize], MaxX[s_RectBatchSize], MaxY[s_RectBatchSize];
+  alignas(32) float U0[s_RectBatchSize], V0[s_RectBatchSize], U1[s_RectBatchSize], V1[s_RectBatchSize];
+  LilU32 Color[s_RectBatchSize];
+  std::size_t Count;
+  LilU32 Culled; // Everything PushRect would have dropped, degenerate rects included
+};
+
+// Moves the lanes of one SIMD group that survived into the batch. Whole groups are the common case
+// (rows of a table are either all visible or all scrolled away), mixed groups fall back to scalar copies.
+inline void CompactLanes(LilRectBatch& batch, const float* lanes, int mask, int width, std::size_t first, const LilU32* colors)
+{
+  const float* minX = lanes;
+  const float* minY = lanes + width;
+  const float* maxX = lanes + 2 * width;
+  const float* maxY = lanes + 3 * width;
+  const float* u0 = lanes + 4 * width;
+  const float* v0 = lanes + 5 * width;
+  const float* u1 = lanes + 6 * width;
+  const float* v1 = lanes + 7 * width;
+  
+  for (int lane = 0; lane < width; ++lane)
+  {
+    if (!(mask & (1 << lane)))
+      continue;
+    
+    const std::size_t n = batch.Count++;
+    batch.MinX[n] = minX[lane];
+    batch.MinY[n] = minY[lane];
+    batch.MaxX[n] = maxX[lane];
+    batch.MaxY[n] = maxY[lane];
+    batch.U0[n] = u0[lane];
+    batch.V0[n] = v0[lane];
+    batch.U1[n] = u1[lane];
+    batch.V1[n] = v1[lane];
+    batch.Color[n] = colors[first + lane];
+  }
+}
+
+constexpr int s_ClipBlockSize = 8; // Lanes of the portable clip path, two NEON (or SSE) registers
+
+// Clips one block of s_ClipBlockSize rects to the cull rect, moving the UVs along, and drops the ones
+// PushRect would drop. The lane loop only computes masks and selects, with no branches or stores that
+// depend on the data, so compilers vectorize it for NEON or whatever else the target has; the
+// compaction is a separate pass, the same one the SSE2/AVX2 paths use.
+inline void ClipRectBlock(LilRectBatch& batch, const LilVec4& cull, const float* xs, const float* ys, const float* ws, const float* hs, const LilU32* colors, std::size_t first)
+{
+  alignas(32) float lanes[s_ClipBlockSize * 8];
+  int keep[s_ClipBlockSize];
+  
+  for (int lane = 0; lane < s_ClipBlockSize; ++lane)
+  {
+    const float x = xs[first + lane], y = ys[first + lane];
+    const float x1 = x + ws[first + lane], y1 = y + hs[first + lane];
+    const float minX = x > cull.x ? x : cull.x;
+    const float minY = y > cull.y ? y : cull.y;
+    const float maxX = x1 < cull.z ? x1 : cull.z;
+    const float maxY = y1 < cull.w ? y1 : cull.w;
+    
+    // The same test as ClipRectUV, so empty, NaN and culled rects all fail it
+    keep[lane] = (maxX > minX) & (maxY > minY);
+    
+    // Divided like ClipRectUV, so sides that aren't clipped get exactly 0 (0 / span) and 1 (span / span)
+    // without a select; multiplying by 1 / span isn't always 1
+    const float spanX = x1 - x, spanY = y1 - y;
+    lanes[lane] = minX;
+    lanes[lane + s_ClipBlockSize] = minY;
+    lanes[lane + 2 * s_ClipBlockSize] = maxX;
+    lanes[lane + 3 * s_ClipBlockSize] = maxY;
+    lanes[lane + 4 * s_ClipBlockSize] = (minX - x) / spanX;
+    lanes[lane + 5 * s_ClipBlockSize] = (minY - y) / spanY;
+    lanes[lane + 6 * s_ClipBlockSize] = (maxX - x) / spanX;
+    lanes[lane + 7 * s_ClipBlockSize] = (maxY - y) / spanY;
+  }
+  
+  int mask = 0;
+  for (int lane = 0; lane < s_ClipBlockSize; ++lane)
+    mask |= keep[lane] << lane;
+  
+  if (mask == (1 << s_ClipBlockSize) - 1)
+  {
+    float* const outputs[8] = { batch.MinX, batch.MinY, batch.MaxX, batch.MaxY, batch.U0, batch.V0, batch.U1, batch.V1 };
+    for (int output = 0; output < 8; ++output)
+      std::memcpy(outputs[output] + batch.Count, lanes + output * s_ClipBlockSize, s_ClipBlockSize * sizeof(float));
+    std::memcpy(batch.Color + batch.Count, colors + first, s_ClipBlockSize * sizeof(LilU32));
+    batch.Count += s_ClipBlockSize;
+  }
+  else if (mask)
+  {
+    CompactLanes(batch, lanes, mask, s_ClipBlockSize, first, colors);
+  }
+}
+
+void ClipRectBatch(LilRectBatch& batch, const LilVec4& cull, const float* xs, const float* ys, const float* ws, const float* hs, const LilU32* colors, std::size_t count)
+{
+  batch.Count = 0;
+  std::size_t i = 0;
+  
+#ifdef LIL_AVX2
+  {
+    const __m256 cullMinX = _mm256_set1_ps(cull.x), cullMinY = _mm256_set1_ps(cull.y);
+    const __m256 cullMaxX = _mm256_set1_ps(cull.z), cullMaxY = _mm256_set1_ps(cull.w);
+    
+    for (; i + 8 <= count; i += 8)
+    {
+      const __m256 x = _mm256_loadu_ps(xs + i), y = _mm256_loadu_ps(ys + i);
+      const __m256 x1 = _mm256_add_ps(x, _mm256_loadu_ps(ws + i)), y1 = _mm256_add_ps(y, _mm256_loadu_ps(hs + i));
+      const __m256 minX = _mm256_max_ps(x, cullMinX), minY = _mm256_max_ps(y, cullMinY);
+      const __m256 maxX = _mm256_min_ps(x1, cullMaxX), maxY = _mm256_min_ps(y1, cullMaxY);
+      
+      // The same test as ClipRectUV, so empty, NaN and culled rects all fail it
+      const int mask = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(maxX, minX, _CMP_GT_OQ), _mm256_cmp_ps(maxY, minY, _CMP_GT_OQ)));
+      if (!mask)
+        continue;
+      
+      // Divided like ClipRectUV, so sides that aren't clipped get exactly 0 and 1
+      const __m256 spanX = _mm256_sub_ps(x1, x), spanY = _mm256_sub_ps(y1, y);
+      const __m256 u0 = _mm256_div_ps(_mm256_sub_ps(minX, x), spanX), v0 = _mm256_div_ps(_mm256_sub_ps(minY, y), spanY);
+      const __m256 u1 = _mm256_div_ps(_mm256_sub_ps(maxX, x), spanX), v1 = _mm256_div_ps(_mm256_sub_ps(maxY, y), spanY);
+      
+      if (mask == 0xff)
+      {
+        const std::size_t n = batch.Count;
+        _mm256_storeu_ps(batch.MinX + n, minX);
+        _mm256_storeu_ps(batch.MinY + n, minY);
+        _mm256_storeu_ps(batch.MaxX + n, maxX);
+        _mm256_storeu_ps(batch.MaxY + n, maxY);
+        _mm256_storeu_ps(batch.U0 + n, u0);
+        _mm256_storeu_ps(batch.V0 + n, v0);
+        _mm256_storeu_ps(batch.U1 + n, u1);
+        _mm256_storeu_ps(batch.V1 + n, v1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(batch.Color + n), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(colors + i)));
+        batch.Count += 8;
+        continue;
+      }
+      
+      alignas(32) float lanes[64];
+      _mm256_store_ps(lanes, minX);
+      _mm256_store_ps(lanes + 8, minY);
+      _mm256_store_ps(lanes + 16, maxX);
+      _mm256_store_ps(lanes + 24, maxY);
+      _mm256_store_ps(lanes + 32, u0);
+      _mm256_store_ps(lanes + 40, v0);
+      _mm256_store_ps(lanes + 48, u1);
+      _mm256_store_ps(lanes + 56, v1);
+      CompactLanes(batch, lanes, mask, 8, i, colors);
+    }
+  }
+#endif
+
+#ifdef LIL_SSE2
+  {
+    const __m128 cullMinX = _mm_set1_ps(cull.x), cullMinY = _mm_set1_ps(cull.y);
+    const __m128 cullMaxX = _mm_set1_ps(cull.z), cullMaxY = _mm_set1_ps(cull.w);
+    
+    for (; i + 4 <= count; i += 4)
+    {
+      const __m128 x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i);
+      const __m128 x1 = _mm_add_ps(x, _mm_loadu_ps(ws + i)), y1 = _mm_add_ps(y, _mm_loadu_ps(hs + i));
+      const __m128 minX = _mm_max_ps(x, cullMinX), minY = _mm_max_ps(y, cullMinY);
+      const __m128 maxX = _mm_min_ps(x1, cullMaxX), maxY = _mm_min_ps(y1, cullMaxY);
+      
+      const int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(maxX, minX), _mm_cmpgt_ps(maxY, minY)));
+      if (!mask)
+        continue;
+      
+      const __m128 spanX = _mm_sub_ps(x1, x), spanY = _mm_sub_ps(y1, y);
+      const __m128 u0 = _mm_div_ps(_mm_sub_ps(minX, x), spanX), v0 = _mm_div_ps(_mm_sub_ps(minY, y), spanY);
+      const __m128 u1 = _mm_div_ps(_mm_sub_ps(maxX, x), spanX), v1 = _mm_div_ps(_mm_sub_ps(maxY, y), spanY);
+      
+      if (mask == 0xf)
+      {
+        const std::size_t n = batch.Count;
+        _mm_storeu_ps(batch.MinX + n, minX);
+        _mm_storeu_ps(batch.MinY + n, minY);
+        _mm_storeu_ps(batch.MaxX + n, maxX);
+        _mm_storeu_ps(batch.MaxY + n, maxY);
+        _mm_storeu_ps(batch.U0 + n, u0);
+        _mm_storeu_ps(batch.V0 + n, v0);
+        _mm_storeu_ps(batch.U1 + n, u1);
+        _mm_storeu_ps(batch.V1 + n, v1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(batch.Color + n), _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i)));
+        batch.Count += 4;
+        continue;
+      }
+      
+      alignas(16) float lanes[32];
+      _mm_store_ps(lanes, minX);
+      _mm_store_ps(lanes + 4, minY);
+      _mm_store_ps(lanes + 8, maxX);
+      _mm_store_ps(lanes + 12, maxY);
+      _mm_store_ps(lanes + 16, u0);
+      _mm_store_ps(lanes + 20, v0);
+      _mm_store_ps(lanes + 24, u1);
+      _mm_store_ps(lanes + 28, v1);
+      CompactLanes(batch, lanes, mask, 4, i, colors);
+    }
+  }
+#endif
+  
+  for (; i + s_ClipBlockSize <= count; i += s_ClipBlockSize)
+    ClipRectBlock(batch, cull, xs, ys, ws, hs, colors, i);
+  
+  // The last partial block is padded with empty rects, which never survive the clip
+  if (i < count)
+  {
+    float x[s_ClipBlockSize] = {}, y[s_ClipBlockSize] = {}, w[s_ClipBlockSize] = {}, h[s_ClipBlockSize] = {};
+    LilU32 color[s_ClipBlockSize] = {};
+    for (std::size_t lane = 0; i + lane < count; ++lane)
+    {
+      x[lane] = xs[i + lane];
+      y[lane] = ys[i + lane];
+      w[lane] = ws[i + lane];
+      h[lane] = hs[i + lane];
+      color[lane] = colors[i + lane];
+    }
+    ClipRectBlock(batch, cull, x, y, w, h, color, 0);
+  }
+  
+  batch.Culled = static_cast<LilU32>(count - batch.Count);
+}
+
+#if defined(LIL_SSE2) && !defined(LIL_COMPACT_VTX)
+static_assert(sizeof(LilVtx) == 6 * sizeof(float), "WriteQuad stores LilVtx as 6 packed floats");
+
+// Interleaves one rect, r = (minX, minY, maxX, maxY), s = (u0, v0, u1, v1) and c = its color in every
+// lane, into its 4 vertices: 24 floats that are pairs of (x, y), (0, u) and (v, color), 6 stores.
+inline void WriteQuad(float* out, __m128 r, __m128 s, __m128 c)
+{
+  const __m128 zu = _mm_and_ps(_mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 2, 0, 0)), _mm_castsi128_ps(_mm_set_epi32(-1, 0, -1, 0))); // 0 u0 0 u1
+  const __m128 vc = _mm_unpacklo_ps(_mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 1, 3, 1)), c); // v0 c v1 c
+  _mm_storeu_ps(out, _mm_shuffle_ps(r, zu, _MM_SHUFFLE(1, 0, 1, 0)));
+  _mm_storeu_ps(out + 4, _mm_shuffle_ps(vc, r, _MM_SHUFFLE(1, 2, 1, 0)));
+  _mm_storeu_ps(out + 8, _mm_shuffle_ps(zu, vc, _MM_SHUFFLE(1, 0, 3, 2)));
+  _mm_storeu_ps(out + 12, _mm_shuffle_ps(r, zu, _MM_SHUFFLE(3, 2, 3, 2)));
+  _mm_storeu_ps(out + 16, _mm_shuffle_ps(vc, r, _MM_SHUFFLE(3, 0, 3, 2)));
+  _mm_storeu_ps(out + 20, _mm_shuffle_ps(zu, vc, _MM_SHUFFLE(3, 2, 1, 0)));
+}
+#endif
+
+// Writes the 4 vertices of every rect in the batch, the same ones PrimRect writes. SSE2 transposes
+// 4 rects at a time from the batch's lanes into one position and one UV vector per rect.
+void WriteRectQuads(const LilRectBatch& batch, LilVtx* vtx)
+{
+  std::size_t i = 0;
+  
+#if defined(LIL_SSE2) && !defined(LIL_COMPACT_VTX)
+  for (; i + 4 <= batch.Count; i += 4, vtx += 16)
+  {
+    __m128 r0 = _mm_load_ps(batch.MinX + i), r1 = _mm_load_ps(batch.MinY + i), r2 = _mm_load_ps(batch.MaxX + i), r3 = _mm_load_ps(batch.MaxY + i);
+    __m128 s0 = _mm_load_ps(batch.U0 + i), s1 = _mm_load_ps(batch.V0 + i), s2 = _mm_load_ps(batch.U1 + i), s3 = _mm_load_ps(batch.V1 + i);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+    
+    const __m128 colors = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.Color + i)));
+    float* out = reinterpret_cast<float*>(vtx);
+    WriteQuad(out, r0, s0, _mm_shuffle_ps(colors, colors, _MM_SHUFFLE(0, 0, 0, 0)));
+    WriteQuad(out + 24, r1, s1, _mm_shuffle_ps(colors, colors, _MM_SHUFFLE(1, 1, 1, 1)));
+    WriteQuad(out + 48, r2, s2, _mm_shuffle_ps(colors, colors, _MM_SHUFFLE(2, 2, 2, 2)));
+    WriteQuad(out + 72, r3, s3, _mm_shuffle_ps(colors, colors, _MM_SHUFFLE(3, 3, 3, 3)));
+  }
+#endif
+  
+  for (; i < batch.Count; ++i, vtx += 4)
+  {
+    const float minX = batch.MinX[i], minY = batch.MinY[i], maxX = batch.MaxX[i], maxY = batch.MaxY[i];
+    const float u0 = batch.U0[i], v0 = batch.V0[i], u1 = batch.U1[i], v1 = batch.V1[i];
+    const LilU32 color = batch.Color[i];
+    
+    new(vtx + 0) LilVtx(LilVec3(minX, minY, 0.0f), LilVec2(u0, v0), color);
+    new(vtx + 1) LilVtx(LilVec3(maxX, minY, 0.0f), LilVec2(u1, v0), color);
+    new(vtx + 2) LilVtx(LilVec3(maxX, maxY, 0.0f), LilVec2(u1, v1), color);
+    new(vtx + 3) LilVtx(LilVec3(minX, maxY, 0.0f), LilVec2(u0, v1), color);
+  }
+}
+
+// 0 1 2 0 2 3 for 4 consecutive quads, relative to the first one's first vertex
+alignas(16) constexpr LilIdx s_QuadIdxPattern[24] = { 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7, 8, 9, 10, 8, 10, 11, 12, 13, 14, 12, 14, 15 };
+
+// Writes 6 indices per rect, 4 rects at a time as the constant pattern plus the first vertex. The
+// portable loop is the same addition, which compilers vectorize.
+void WriteQuadIndices(LilIdx* idx, LilU32 base, std::size_t count)
+{
+  std::size_t i = 0;
+  
+#ifdef LIL_SSE2
+  constexpr int lanes = static_cast<int>(16 / sizeof(LilIdx));
+  const __m128i first = sizeof(LilIdx) == 2 ? _mm_set1_epi16(static_cast<short>(base)) : _mm_set1_epi32(static_cast<int>(base));
+  const __m128i step = sizeof(LilIdx) == 2 ? _mm_set1_epi16(16) : _mm_set1_epi32(16);
+  __m128i offset = first;
+  for (; i + 4 <= count; i += 4, idx += 24, base += 16)
+  {
+    for (int k = 0; k < 24; k += lanes)
+    {
+      const __m128i pattern = _mm_load_si128(reinterpret_cast<const __m128i*>(s_QuadIdxPattern + k));
+      const __m128i value = sizeof(LilIdx) == 2 ? _mm_add_epi16(pattern, offset) : _mm_add_epi32(pattern, offset);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(idx + k), value);
+    }
+    offset = sizeof(LilIdx) == 2 ? _mm_add_epi16(offset, step) : _mm_add_epi32(offset, step);
+  }
+#else
+  for (; i + 4 <= count; i += 4, idx += 24, base += 16)
+  {
+    for (int k = 0; k < 24; ++k)
+      idx[k] = static_cast<LilIdx>(s_QuadIdxPattern[k] + base);
+  }
+#endif
+  
+  for (; i < count; ++i, idx += 6, base += 4)
+  {
+    idx[0] = static_cast<LilIdx>(base);
+    idx[1] = static_cast<LilIdx>(base + 1);
+    idx[2] = static_cast<LilIdx>(base + 2);
+    idx[3] = static_cast<LilIdx>(base);
+    idx[4] = static_cast<LilIdx>(base + 2);
+    idx[5] = static_cast<LilIdx>(base + 3);
+  }
+}
+
+#ifdef LIL_SSE2
+static_assert(sizeof(LilRectInstance) == 32, "WriteRectInstances stores LilRectInstance as two 16 byte halves");
+
+// LilRectInstance::ToUNorm16 for 4 lanes, the max/min order keeps NaN at 0 like the scalar cast
+inline __m128i ToUNorm16(__m128 value)
+{
+  const __m128 clamped = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+  return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(65535.0f)), _mm_set1_ps(0.5f)));
+}
+#endif
+
+// Writes one LilRectInstance per rect in the batch. SSE2 converts the UVs of 4 rects at a time and
+// transposes them, with color and texture, into the second half of each record.
+void WriteRectInstances(const LilRectBatch& batch, LilU32 textureID, LilRectInstance* rect)
+{
+  std::size_t i = 0;
+  
+#ifdef LIL_SSE2
+  const __m128 texture = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(textureID)));
+  for (; i + 4 <= batch.Count; i += 4, rect += 4)
+  {
+    __m128 r0 = _mm_load_ps(batch.MinX + i), r1 = _mm_load_ps(batch.MinY + i), r2 = _mm_load_ps(batch.MaxX + i), r3 = _mm_load_ps(batch.MaxY + i);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    
+    // UV[0..1] and UV[2..3] are one 32-bit word each, x in the low half
+    __m128 q0 = _mm_castsi128_ps(_mm_or_si128(ToUNorm16(_mm_load_ps(batch.U0 + i)), _mm_slli_epi32(ToUNorm16(_mm_load_ps(batch.V0 + i)), 16)));
+    __m128 q1 = _mm_castsi128_ps(_mm_or_si128(ToUNorm16(_mm_load_ps(batch.U1 + i)), _mm_slli_epi32(ToUNorm16(_mm_load_ps(batch.V1 + i)), 16)));
+    __m128 q2 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.Color + i)));
+    __m128 q3 = texture;
+    _MM_TRANSPOSE4_PS(q0, q1, q2, q3);
+    
+    float* out = reinterpret_cast<float*>(rect);
+    _mm_storeu_ps(out, r0);
+    _mm_storeu_ps(out + 4, q0);
+    _mm_storeu_ps(out + 8, r1);
+    _mm_storeu_ps(out + 12, q1);
+    _mm_storeu_ps(out + 16, r2);
+    _mm_storeu_ps(out + 20, q2);
+    _mm_storeu_ps(out + 24, r3);
+    _mm_storeu_ps(out + 28, q3);
+  }
+#endif
+  
+  for (; i < batch.Count; ++i, ++rect)
+    new(rect) LilRectInstance(LilVec2(batch.MinX[i], batch.MinY[i]), LilVec2(batch.MaxX[i], batch.MaxY[i]),
+                              LilVec2(batch.U0[i], batch.V0[i]), LilVec2(batch.U1[i], batch.V1[i]), batch.Color[i], textureID);
+}
+
+} // namespace
+
+void LilDrawList::PushRects(const float* x, const float* y, const float* w, const float* h, const LilU32* colors, std::size_t count)
+{
+  LIL_PROFILE_SCOPE("LilDrawList::PushRects");
+  
+  // Every rect ends up inside CullRect, so one check per call keeps them all in the open command
+  if (!ContainsRect(DrawCmds.Back().ClipRect, LilVec2(CullRect.x, CullRect.y), LilVec2(CullRect.z, CullRect.w)))
+    SetDrawCmdState(DrawCmds.Back().TextureID, Lil::NoClipRect);
+  
+  const bool instancing = Flags & LilDrawListFlags_RectInstancing;
+  const LilU32 idxPerRect = (Flags & LilDrawListFlags_QuadIndexing) ? 0 : 6;
+  LilRectBatch batch;
+  
+  for (std::size_t first = 0; first < count; first += s_RectBatchSize)
+  {
+    const std::size_t size = count - first < s_RectBatchSize ? count - first : s_RectBatchSize;
+    ClipRectBatch(batch, CullRect, x + first, y + first, w + first, h + first, colors + first, size);
+    CulledPrims += batch.Culled;
+    if (batch.Count == 0)
+      continue;
+    
+    if (instancing)
+    {
+      if (HasTriangles(*this, DrawCmds.Back()))
+        AddDrawCmd();
+      
+      WriteRectInstances(batch, DrawCmds.Back().TextureID, RectArray.Append(batch.Count));
+      continue;
+    }
+    
+    // One reserve per batch; a batch is far below the 16-bit limit, so it never straddles two commands
+    const LilU32 rects = static_cast<LilU32>(batch.Count);
+    ReserveGeometry(idxPerRect * rects, 4 * rects);
+    WriteRectQuads(batch, VtxWritePtr);
+    VtxWritePtr += 4 * rects;
+    if (idxPerRect)
+    {
+      WriteQuadIndices(IdxWritePtr, VtxOffset, batch.Count);
+      IdxWritePtr += 6 * rects;
+    }
+    VtxOffset += 4 * rects;
+  }
+}
+
 /*
 --------------------------------------------------
 ----- IMPLEMENTATION (LilContext) ----------------
@@ -47,10 +922,24 @@ namespace Lil
 {
 
 static LilContext s_Context;
+static thread_local LilDrawList* s_CurrentDrawList = nullptr; // nullptr means the user draw list
+
+#ifdef LIL_PROFILE
+static std::uint64_t s_UserStart = 0; // Where the user zone between BeginFrame and RenderFrame begins
+#endif
+
+static void SweepTextLayouts();
+static void DeleteTextLayout(LilCachedTextLayout* entry);
+
+static double GetTimeMs()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 void CreateContext()
 {
   s_Context.DrawLists.EmplaceBack(); // Create a DrawList
+  s_Context.ActiveFont.BuildDefault();
 }
 
 LilContext& GetContext()
@@ -61,6 +950,15 @@ LilContext& GetContext()
 void DestroyContext()
 {
   // Global initialization will go here when needed
+  LilTextLayoutCache& cache = s_Context.TextLayouts;
+  for (LilCachedTextLayout* entry : cache.Entries)
+    DeleteTextLayout(entry);
+  for (LilTextLayout* layout : cache.Retired)
+    delete layout;
+  cache.Entries.Shrink(0);
+  cache.LastUsedFrames.Shrink(0);
+  cache.Retired.Shrink(0);
+  cache.Table.Shrink(0);
 }
 
 LilArray<LilDrawList>& GetDrawLists()
@@ -68,16 +966,284 @@ LilArray<LilDrawList>& GetDrawLists()
   return s_Context.DrawLists;
 }
 
+void SetDrawList(LilDrawList* drawList)
+{
+  // The user draw list is kept as nullptr, so it survives the draw lists moving
+  s_CurrentDrawList = drawList == &s_Context.DrawLists[0] ? nullptr : drawList;
+}
+
+LilDrawList& GetDrawList()
+{
+  return s_CurrentDrawList ? *s_CurrentDrawList : s_Context.DrawLists[0];
+}
+
+void SetPanelCount(std::size_t count)
+{
+  s_Context.DrawLists.Resize(count + 1);
+}
+
+std::size_t GetPanelCount()
+{
+  return s_Context.DrawLists.GetSize() - 1;
+}
+
+LilDrawList& GetPanelDrawList(std::size_t panel)
+{
+  return s_Context.DrawLists[panel + 1];
+}
+
 void BeginFrame()
 {
+  LIL_PROFILE_SCOPE("Lil::BeginFrame");
+  
+  LilFrameTimes& times = s_Context.FrameTimes;
+  const LilAllocatorStats heap = LilHeapAllocator::GetStats();
+  times.BeginFrameStart = GetTimeMs();
+  times.HeapAllocations = heap.Allocations;
+  times.HeapReallocations = heap.Reallocations;
+  const LilFrameAllocator::Counters& arena = LilFrameAllocator::GetCounters();
+  times.ArenaBlocks = arena.Blocks.load(std::memory_order_relaxed);
+  times.ArenaBytes = arena.Bytes.load(std::memory_order_relaxed);
+  
   for (auto& drawList : GetDrawLists())
     drawList.Clear();
+  s_Context.ActiveFont.NewFrame();
+  SweepTextLayouts();
+  times.TextLayoutMisses = s_Context.TextLayouts.Misses;
+  
+  // Per-frame containers have released their storage by now, so every thread's arena can be reclaimed in one go
+  LilFrameAllocator::NewFrame();
+  
+  times.BeginFrameEnd = GetTimeMs();
+#ifdef LIL_PROFILE
+  s_UserStart = GetProfileTime();
+#endif
 }
 
 void RenderFrame()
 {
+  LIL_PROFILE_RECORD("Lil::User", s_UserStart, GetProfileTime());
+  LIL_PROFILE_SCOPE("Lil::RenderFrame");
+  
+  const double renderStart = GetTimeMs();
+  
+  // Lists are finalized (and later drawn) in index order, whichever thread recorded them
+  LilFrameStats stats;
   for (auto& drawList : GetDrawLists())
+  {
     drawList.Render();
+    stats.Vertices += drawList.VtxArray.GetSize();
+    stats.Indices += drawList.IdxArray.GetSize();
+    stats.RectInstances += drawList.RectArray.GetSize();
+    stats.DrawCmds += drawList.DrawCmds.GetSize();
+    stats.CulledPrims += drawList.CulledPrims;
+  }
+  stats.DrawLists = GetDrawLists().GetSize();
+  stats.Bytes = stats.Vertices * sizeof(LilVtx) + stats.Indices * sizeof(LilIdx) + stats.RectInstances * sizeof(LilRectInstance);
+  
+  // Heap and arena counters are diffed against the snapshot BeginFrame took
+  const LilFrameTimes& times = s_Context.FrameTimes;
+  const LilAllocatorStats heap = LilHeapAllocator::GetStats();
+  const LilFrameAllocator::Counters& arena = LilFrameAllocator::GetCounters();
+  stats.HeapAllocations = heap.Allocations - times.HeapAllocations;
+  stats.HeapReallocations = heap.Reallocations - times.HeapReallocations;
+  stats.ArenaBlocks = arena.Blocks.load(std::memory_order_relaxed) - times.ArenaBlocks;
+  stats.ArenaBytes = arena.Bytes.load(std::memory_order_relaxed) - times.ArenaBytes;
+  
+  {
+    std::lock_guard<std::mutex> lock(s_Context.TextLayouts.Lock);
+    stats.TextLayouts = s_Context.TextLayouts.Entries.GetSize();
+    stats.TextLayoutMisses = s_Context.TextLayouts.Misses - times.TextLayoutMisses;
+  }
+  
+  stats.BeginFrameMs = times.BeginFrameEnd - times.BeginFrameStart;
+  stats.UserMs = renderStart - times.BeginFrameEnd;
+  stats.RenderFrameMs = GetTimeMs() - renderStart;
+  s_Context.FrameStats = stats;
+}
+
+const LilFrameStats& GetFrameStats()
+{
+  return s_Context.FrameStats;
+}
+
+// Hashes 8 bytes at a time; the key is compared in full on a hit, so this only has to spread well
+static std::uint64_t MixHash(std::uint64_t hash)
+{
+  hash *= 0xbf58476d1ce4e5b9ull;
+  return hash ^ (hash >> 31);
+}
+
+static std::uint64_t HashTextLayoutKey(const char* text, std::size_t length, const LilFont* font, float size, float wrapWidth)
+{
+  std::uint64_t hash = MixHash(0x9e3779b97f4a7c15ull ^ length);
+  std::size_t i = 0;
+  for (; i + 8 <= length; i += 8)
+  {
+    std::uint64_t chunk;
+    std::memcpy(&chunk, text + i, 8);
+    hash = MixHash(hash ^ chunk);
+  }
+  
+  std::uint64_t tail = 0;
+  std::memcpy(&tail, text + i, length - i);
+  hash = MixHash(hash ^ tail);
+  
+  std::uint32_t sizeBits, wrapBits;
+  std::memcpy(&sizeBits, &size, 4);
+  std::memcpy(&wrapBits, &wrapWidth, 4);
+  hash = MixHash(hash ^ (static_cast<std::uint64_t>(wrapBits) << 32 | sizeBits));
+  return MixHash(hash ^ reinterpret_cast<std::uintptr_t>(font));
+}
+
+static LilU32 FindTextLayout(const LilTextLayoutCache& cache, std::uint64_t hash, const char* text, std::size_t length, const LilFont* font, float size, float wrapWidth)
+{
+  if (cache.Table.Empty())
+    return LilTextLayoutCache::EmptyBucket;
+  
+  const std::size_t mask = cache.Table.GetSize() - 1;
+  for (std::size_t i = static_cast<std::size_t>(hash) & mask;; i = (i + 1) & mask)
+  {
+    const LilTextLayoutCache::Bucket& bucket = cache.Table[i];
+    if (bucket.Entry == LilTextLayoutCache::EmptyBucket)
+      return LilTextLayoutCache::EmptyBucket;
+    if (bucket.Hash != hash)
+      continue;
+    
+    const LilCachedTextLayout& entry = *cache.Entries[bucket.Entry];
+    if (entry.Font == font && entry.Size == size && entry.WrapWidth == wrapWidth && entry.Text.GetSize() == length &&
+        (length == 0 || std::memcmp(entry.Text.begin(), text, length) == 0))
+      return bucket.Entry;
+  }
+}
+
+static void InsertTextLayoutBucket(LilTextLayoutCache& cache, std::uint64_t hash, LilU32 entry)
+{
+  const std::size_t mask = cache.Table.GetSize() - 1;
+  std::size_t i = static_cast<std::size_t>(hash) & mask;
+  while (cache.Table[i].Entry != LilTextLayoutCache::EmptyBucket)
+    i = (i + 1) & mask;
+  cache.Table[i] = { hash, entry };
+}
+
+// Rebuilt after evictions too, since those move entries around
+static void RebuildTextLayoutTable(LilTextLayoutCache& cache, std::size_t size)
+{
+  cache.Table.Shrink(0);
+  cache.Table.Resize(size);
+  for (LilTextLayoutCache::Bucket& bucket : cache.Table)
+    bucket.Entry = LilTextLayoutCache::EmptyBucket;
+  
+  for (std::size_t i = 0; i < cache.Entries.GetSize(); ++i)
+    InsertTextLayoutBucket(cache, cache.Entries[i]->Hash, static_cast<LilU32>(i));
+}
+
+static void DeleteTextLayout(LilCachedTextLayout* entry)
+{
+  delete entry->Layout;
+  delete entry;
+}
+
+static void SweepTextLayouts()
+{
+  LilTextLayoutCache& cache = s_Context.TextLayouts;
+  std::lock_guard<std::mutex> lock(cache.Lock);
+  
+  ++cache.Frame;
+  for (LilTextLayout* layout : cache.Retired)
+    delete layout;
+  cache.Retired.Shrink(0);
+  
+  // Swap-remove keeps the arrays dense; the table only has to be rebuilt when something went
+  std::size_t evicted = 0;
+  for (std::size_t i = 0; i < cache.Entries.GetSize();)
+  {
+    if (cache.Frame - cache.LastUsedFrames[i] <= cache.MaxUnusedFrames)
+    {
+      ++i;
+      continue;
+    }
+    
+    DeleteTextLayout(cache.Entries[i]);
+    cache.Entries[i] = cache.Entries.Back();
+    cache.LastUsedFrames[i] = cache.LastUsedFrames.Back();
+    cache.Entries.PopBack();
+    cache.LastUsedFrames.PopBack();
+    ++evicted;
+  }
+  
+  if (evicted)
+  {
+    cache.Evictions += evicted;
+    RebuildTextLayoutTable(cache, cache.Table.GetSize());
+  }
+}
+
+const LilTextLayout& GetTextLayout(const char* text, const char* textEnd, float size, float wrapWidth)
+{
+  // A font that was never built has no line height to scale by (and no glyphs to lay out)
+  static const LilTextLayout s_EmptyTextLayout;
+  LilFont& font = s_Context.ActiveFont;
+  if (!(font.LineHeight > 0.0f))
+    return s_EmptyTextLayout;
+  
+  if (!textEnd)
+    textEnd = text + std::strlen(text);
+  
+  LilTextLayoutCache& cache = s_Context.TextLayouts;
+  const std::size_t length = static_cast<std::size_t>(textEnd - text);
+  const std::uint64_t hash = HashTextLayoutKey(text, length, &font, size, wrapWidth);
+  
+  {
+    std::lock_guard<std::mutex> lock(cache.Lock);
+    const LilU32 index = FindTextLayout(cache, hash, text, length, &font, size, wrapWidth);
+    if (index != LilTextLayoutCache::EmptyBucket && font.AcquireLayout(*cache.Entries[index]->Layout))
+    {
+      cache.LastUsedFrames[index] = cache.Frame;
+      ++cache.Hits;
+      return *cache.Entries[index]->Layout;
+    }
+  }
+  
+  // Laid out without holding the lock, so other threads can keep hitting the cache meanwhile
+  const float scale = size / font.LineHeight;
+  LilTextLayout* layout = new LilTextLayout();
+  font.LayoutText(text, textEnd, LilVec2(scale, scale), wrapWidth, *layout);
+  
+  std::lock_guard<std::mutex> lock(cache.Lock);
+  ++cache.Misses;
+  
+  // Another thread may have laid out the same text in the meantime; the old layout stays alive
+  // until the next BeginFrame, in case someone is still copying it
+  const LilU32 index = FindTextLayout(cache, hash, text, length, &font, size, wrapWidth);
+  if (index != LilTextLayoutCache::EmptyBucket)
+  {
+    LilCachedTextLayout& entry = *cache.Entries[index];
+    cache.Retired.PushBack(entry.Layout);
+    entry.Layout = layout;
+    cache.LastUsedFrames[index] = cache.Frame;
+    return *layout;
+  }
+  
+  LilCachedTextLayout* entry = new LilCachedTextLayout();
+  entry->Hash = hash;
+  entry->Font = &font;
+  entry->Size = size;
+  entry->WrapWidth = wrapWidth;
+  entry->Text.Resize(length);
+  if (length)
+    std::memcpy(entry->Text.begin(), text, length);
+  entry->Layout = layout;
+  
+  // Grown at half load, probe sequences stay short
+  if ((cache.Entries.GetSize() + 1) * 2 > cache.Table.GetSize())
+    RebuildTextLayoutTable(cache, cache.Table.Empty() ? 256 : cache.Table.GetSize() * 2);
+  
+  const LilU32 newIndex = static_cast<LilU32>(cache.Entries.GetSize());
+  cache.Entries.PushBack(entry);
+  cache.LastUsedFrames.PushBack(cache.Frame);
+  InsertTextLayoutBucket(cache, hash, newIndex);
+  return *layout;
 }
 
 } // namespace Lil
@@ -96,7 +1262,34 @@ void Rect(float x, float y, float w, float h, LilU32 color)
   if (w <= 0 || h <= 0)
     return;
   
-  GetDrawLists()[0].PushRect({x, y}, {x + w, y + h}, color);
+  LilDrawList& drawList = GetDrawList();
+  if (!drawList.IsRectVisible({x, y}, {x + w, y + h}))
+    return;
+  
+  drawList.PushRect({x, y}, {x + w, y + h}, color);
+}
+
+void Text(float x, float y, const char* text, float size, LilU32 color)
+{
+  const LilTextLayout& layout = GetTextLayout(text, nullptr, size);
+  GetDrawList().PushTextLayout(layout, GetContext().ActiveFont.TextureID, LilVec2(x, y), color);
+}
+
+void TextWrapped(float x, float y, const char* text, float size, float wrapWidth, LilU32 color)
+{
+  const LilTextLayout& layout = GetTextLayout(text, nullptr, size, wrapWidth);
+  GetDrawList().PushTextLayout(layout, GetContext().ActiveFont.TextureID, LilVec2(x, y), color);
+}
+
+LilVec2 CalcTextSize(const char* text, float size, float wrapWidth)
+{
+  // Measuring caches the layout, so drawing the text right after is a hit
+  return GetTextLayout(text, nullptr, size, wrapWidth).Size;
+}
+
+void Rects(const float* x, const float* y, const float* w, const float* h, const LilU32* colors, std::size_t count)
+{
+  GetDrawList().PushRects(x, y, w, h, colors, count);
 }
 
 } // namespace Lil
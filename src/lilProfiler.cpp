@@ -0,0 +1,150 @@
+#include "lilProfiler.h"
+#include "lilArray.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilProfiler) ---------------
+--------------------------------------------------
+*/
+
+namespace Lil
+{
+
+// Rings are owned here and never freed, a thread's ring has to survive the thread. Rings of exited
+// threads wait in FreeRings for the next new thread, so short-lived workers don't add a ring each.
+struct LilProfilerData
+{
+  std::mutex Lock;
+  LilArray<LilProfileRing*> Rings;
+  LilArray<LilProfileRing*> FreeRings;
+};
+
+static LilProfilerData s_Profiler;
+static thread_local LilProfileRing* s_ThreadRing = nullptr;
+
+// Hands the ring back when its thread exits. Kept apart from s_ThreadRing, which stays trivial so
+// recording doesn't go through the thread_local init guard.
+struct LilThreadRingOwner
+{
+  LilProfileRing* Ring = nullptr;
+
+  ~LilThreadRingOwner()
+  {
+    if (!Ring)
+      return;
+
+    std::lock_guard<std::mutex> lock(s_Profiler.Lock);
+    s_Profiler.FreeRings.PushBack(Ring);
+  }
+};
+
+static thread_local LilThreadRingOwner s_ThreadRingOwner;
+
+std::uint64_t GetProfileTime()
+{
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+LilProfileRing& GetProfileRing()
+{
+  if (!s_ThreadRing)
+  {
+    std::lock_guard<std::mutex> lock(s_Profiler.Lock);
+    if (!s_Profiler.FreeRings.Empty())
+    {
+      // Keeps the old thread's events, this thread's are recorded after them under the same tid
+      s_ThreadRing = s_Profiler.FreeRings.Back();
+      s_Profiler.FreeRings.PopBack();
+    }
+    else
+    {
+      s_ThreadRing = new LilProfileRing();
+      s_ThreadRing->ThreadID = static_cast<std::uint32_t>(s_Profiler.Rings.GetSize());
+      s_Profiler.Rings.PushBack(s_ThreadRing);
+    }
+    s_ThreadRingOwner.Ring = s_ThreadRing;
+  }
+
+  return *s_ThreadRing;
+}
+
+void RecordProfileEvent(const char* name, std::uint64_t start, std::uint64_t end)
+{
+  GetProfileRing().Record(name, start, end);
+}
+
+static void WriteJsonString(std::FILE* file, const char* str)
+{
+  std::fputc('"', file);
+  for (; *str; ++str)
+  {
+    if (*str == '"' || *str == '\\')
+      std::fputc('\\', file);
+    if (static_cast<unsigned char>(*str) >= 0x20)
+      std::fputc(*str, file);
+  }
+  std::fputc('"', file);
+}
+
+bool WriteChromeTrace(const char* path)
+{
+  std::FILE* file = std::fopen(path, "w");
+  if (!file)
+    return false;
+
+  std::lock_guard<std::mutex> lock(s_Profiler.Lock);
+
+  // Rings are copied first (owners may keep recording), dropping slots overwritten during the copy
+  LilArray<LilProfileEvent> events;
+  LilArray<std::uint32_t> threadIDs;
+  for (LilProfileRing* ring : s_Profiler.Rings)
+  {
+    const std::uint64_t written = ring->Written.load(std::memory_order_acquire);
+    const std::uint64_t first = written > LilProfileRing::Capacity ? written - LilProfileRing::Capacity : 0;
+    for (std::uint64_t i = first; i < written; ++i)
+    {
+      LilProfileEvent event;
+      if (!ring->Read(i, event))
+        continue;
+      events.PushBack(event);
+      threadIDs.PushBack(ring->ThreadID);
+    }
+  }
+
+  // Timestamps are made relative to the oldest event so the viewer starts at zero
+  std::uint64_t origin = ~std::uint64_t(0);
+  for (const LilProfileEvent& event : events)
+    origin = std::min(origin, event.Start);
+
+  std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+
+  for (std::size_t i = 0; i < events.GetSize(); ++i)
+  {
+    const LilProfileEvent& event = events[i];
+
+    std::fputs(i == 0 ? "\n" : ",\n", file);
+    std::fputs("{\"name\":", file);
+    WriteJsonString(file, event.Name);
+    std::fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+                 static_cast<double>(event.Start - origin) / 1000.0,
+                 static_cast<double>(event.Duration) / 1000.0,
+                 threadIDs[i]);
+  }
+
+  std::fputs("\n]}\n", file);
+  return std::fclose(file) == 0;
+}
+
+void ClearProfile()
+{
+  std::lock_guard<std::mutex> lock(s_Profiler.Lock);
+  for (LilProfileRing* ring : s_Profiler.Rings)
+    ring->Written.store(0, std::memory_order_release);
+}
+
+} // namespace Lil
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+--------------------------------------------------
+----- SECTION (LilProfiler) ----------------------
+--------------------------------------------------
+
+LIL_PROFILE_SCOPE(name) times the rest of the enclosing scope
+and records it as a zone. Zones only exist when the library
+(and the code using the macro) is built with LIL_PROFILE
+defined (premake5 --profile), otherwise the macro expands to
+nothing and none of this is compiled into the hot paths.
+
+Every thread records into its own fixed-size ring buffer, so
+recording never takes a lock: the owning thread is the only
+writer and publishes each event with a release store. When a
+ring is full the oldest events are overwritten. Rings are
+registered (under a lock) the first time a thread records and
+outlive their thread, so its events can still be dumped. When
+a thread exits its ring goes back to a free list and the next
+new thread records into it, after the old events, so workers
+started per frame or per build share as many rings as ever
+ran at once. A tid in the trace is such a ring, not one OS
+thread.
+
+Lil::WriteChromeTrace dumps every ring as Chrome Trace Event
+JSON (chrome://tracing, Perfetto, Speedscope). It can run while
+other threads record: a ring's slots are relaxed atomics and
+act as a seqlock with Written, so after copying an event it
+checks Written again and drops the event if the owning thread
+has started to overwrite that slot meanwhile. Events recorded
+while it runs may or may not make it into the file, but none
+comes out torn. Calling it between frames still keeps the most.
+
+Zone names must be string literals (or otherwise outlive the
+capture), only the pointer is stored.
+
+-- TODO --
+1) N/A
+*/
+
+struct LilProfileEvent
+{
+  const char* Name;
+  std::uint64_t Start; // Nanoseconds on the steady clock
+  std::uint64_t Duration;
+};
+
+class LilProfileRing
+{
+public:
+  static constexpr std::uint32_t Capacity = 1 << 14; // Power of two so the write index can wrap freely
+
+  // Relaxed atomics (plain moves on x86 and ARM) so a reader may copy a slot while it is overwritten
+  struct Slot
+  {
+    std::atomic<const char*> Name{ nullptr };
+    std::atomic<std::uint64_t> Start{ 0 };
+    std::atomic<std::uint64_t> Duration{ 0 };
+  };
+
+  Slot Events[Capacity];
+  std::atomic<std::uint64_t> Written{ 0 }; // Total events ever recorded, only the owning thread stores
+  std::uint32_t ThreadID = 0;
+
+  void Record(const char* name, std::uint64_t start, std::uint64_t end)
+  {
+    const std::uint64_t index = Written.load(std::memory_order_relaxed);
+    Slot& slot = Events[index & (Capacity - 1)];
+
+    // Written == index already announces that event index - Capacity is being replaced; the fence
+    // keeps these stores after it for a reader that sees one of them (see Read)
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.Name.store(name, std::memory_order_relaxed);
+    slot.Start.store(start, std::memory_order_relaxed);
+    slot.Duration.store(end - start, std::memory_order_relaxed);
+    Written.store(index + 1, std::memory_order_release);
+  }
+
+  // Copies event index (one of the last Capacity published ones) from any thread. Returns false when
+  // the owner overwrote the slot meanwhile, the copy may be torn then.
+  bool Read(std::uint64_t index, LilProfileEvent& event) const
+  {
+    const Slot& slot = Events[index & (Capacity - 1)];
+    event.Name = slot.Name.load(std::memory_order_relaxed);
+    event.Start = slot.Start.load(std::memory_order_relaxed);
+    event.Duration = slot.Duration.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return index + Capacity > Written.load(std::memory_order_relaxed);
+  }
+};
+
+namespace Lil
+{
+
+std::uint64_t GetProfileTime();
+LilProfileRing& GetProfileRing(); // The calling thread's ring, registered on first use
+void RecordProfileEvent(const char* name, std::uint64_t start, std::uint64_t end);
+
+bool WriteChromeTrace(const char* path);
+void ClearProfile(); // Drops every recorded event; only call while no thread is recording
+
+} // namespace Lil
+
+struct LilProfileZone
+{
+  const char* Name;
+  std::uint64_t Start;
+
+  LilProfileZone(const char* name)
+    : Name(name), Start(Lil::GetProfileTime()) {}
+
+  ~LilProfileZone() { Lil::RecordProfileEvent(Name, Start, Lil::GetProfileTime()); }
+
+  LilProfileZone(const LilProfileZone&) = delete;
+  LilProfileZone& operator=(const LilProfileZone&) = delete;
+};
+
+#ifdef LIL_PROFILE
+#define LIL_PROFILE_CONCAT_IMPL(a, b) a##b
+#define LIL_PROFILE_CONCAT(a, b) LIL_PROFILE_CONCAT_IMPL(a, b)
+#define LIL_PROFILE_SCOPE(name) LilProfileZone LIL_PROFILE_CONCAT(lilProfileZone, __LINE__)(name)
+#define LIL_PROFILE_RECORD(name, start, end) Lil::RecordProfileEvent(name, start, end)
+#else
+#define LIL_PROFILE_SCOPE(name)
+#define LIL_PROFILE_RECORD(name, start, end)
+#endif
@@ -0,0 +1,719 @@
+#include "lilRasterizer.h"
+#include "lilProfiler.h"
+
+#include <cmath>
+#include <cstdio>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIL_RASTER_SSE2
+#include <emmintrin.h>
+#endif
+
+LilRasterizer::LilRasterizerData LilRasterizer::s_Data;
+
+static constexpr int s_TileSize = 64; // Must be a multiple of 4 so pixel groups never straddle tiles
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilRasterizer Helpers) -----
+--------------------------------------------------
+*/
+
+static inline int LilMin(int a, int b) { return a < b ? a : b; }
+static inline int LilMax(int a, int b) { return a > b ? a : b; }
+static inline float LilMin(float a, float b) { return a < b ? a : b; }
+static inline float LilMax(float a, float b) { return a > b ? a : b; }
+
+// dst = src * srcAlpha + dst * (1 - srcAlpha) for every channel, alpha included (matches glBlendFunc)
+static inline LilU32 BlendPixel(LilU32 src, LilU32 dst)
+{
+  LilU32 alpha = src >> 24;
+  LilU32 invAlpha = 255 - alpha;
+  LilU32 result = 0;
+
+  for (int shift = 0; shift < 32; shift += 8)
+  {
+    LilU32 value = ((src >> shift) & 0xff) * alpha + ((dst >> shift) & 0xff) * invAlpha + 128;
+    result |= ((value + (value >> 8)) >> 8) << shift;
+  }
+
+  return result;
+}
+
+static inline LilU32 PackChannel(float value, int shift)
+{
+  value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+  return static_cast<LilU32>(value * 255.0f + 0.5f) << shift;
+}
+
+static inline bool IsRegionCovered(const float* a, const float* b, const float* c, const float* bias, int x0, int y0, int x1, int y1)
+{
+  const float xs[2] = { static_cast<float>(x0), static_cast<float>(x1 - 1) };
+  const float ys[2] = { static_cast<float>(y0), static_cast<float>(y1 - 1) };
+
+  for (int edge = 0; edge < 3; ++edge)
+    for (int corner = 0; corner < 4; ++corner)
+      if (!(a[edge] * xs[corner & 1] + b[edge] * ys[corner >> 1] + c[edge] > bias[edge]))
+        return false;
+
+  return true;
+}
+
+#ifdef LIL_RASTER_SSE2
+// Four pixel version of BlendPixel using 16-bit lanes
+static inline __m128i BlendPixels4(__m128i src, __m128i dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i full = _mm_set1_epi16(255);
+  const __m128i round = _mm_set1_epi16(128);
+
+  __m128i srcLo = _mm_unpacklo_epi8(src, zero);
+  __m128i srcHi = _mm_unpackhi_epi8(src, zero);
+  __m128i dstLo = _mm_unpacklo_epi8(dst, zero);
+  __m128i dstHi = _mm_unpackhi_epi8(dst, zero);
+
+  __m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  __m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+  __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(srcLo, alphaLo), _mm_mullo_epi16(dstLo, _mm_sub_epi16(full, alphaLo))), round);
+  __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(srcHi, alphaHi), _mm_mullo_epi16(dstHi, _mm_sub_epi16(full, alphaHi))), round);
+  lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+  hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+  return _mm_packus_epi16(lo, hi);
+}
+
+static inline __m128i SelectPixels4(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+/*
+--------------------------------------------------
+----- IMPLEMENTATION (LilRasterizer) -------------
+--------------------------------------------------
+*/
+
+void LilRasterizer::Init(int width, int height)
+{
+  s_Data.Pixels = nullptr;
+  OnResize(width, height);
+
+  Lil::CreateContext();
+  UpdateFontTexture(Lil::GetContext().ActiveFont);
+}
+
+void LilRasterizer::UpdateFontTexture(LilFont& font)
+{
+  s_Data.AtlasUpdates.Shrink(0);
+  font.TakeAtlasUpdates(s_Data.AtlasUpdates);
+
+  if (font.AtlasDirty || !font.TextureID)
+  {
+    DestroyTexture(font.TextureID);
+    font.TextureID = CreateTexture(font.AtlasWidth, font.AtlasHeight, nullptr);
+    s_Data.AtlasUpdates.Shrink(0);
+    s_Data.AtlasUpdates.PushBack({ 0, 0, font.AtlasWidth, font.AtlasHeight });
+    font.AtlasDirty = false;
+  }
+
+  LilRasterTexture& texture = s_Data.Textures[font.TextureID - 1];
+  texture.DistanceRange = font.DistanceRange;
+  for (const LilAtlasRect& rect : s_Data.AtlasUpdates)
+  {
+    for (int y = rect.Y; y < rect.Y + rect.Height; ++y)
+    {
+      const unsigned char* src = &font.AtlasPixels[static_cast<std::size_t>(y) * font.AtlasWidth];
+      LilU32* dst = texture.Pixels + static_cast<std::size_t>(y) * texture.Width;
+      for (int x = rect.X; x < rect.X + rect.Width; ++x)
+        dst[x] = (static_cast<LilU32>(src[x]) << 24) | 0x00ffffff;
+    }
+  }
+}
+
+void LilRasterizer::Terminate()
+{
+  Lil::GetContext().ActiveFont.TextureID = 0;
+  Lil::DestroyContext();
+
+  for (auto& texture : s_Data.Textures)
+    operator delete(texture.Pixels);
+  s_Data.Textures.Clear();
+
+  operator delete(s_Data.Pixels);
+  s_Data.Pixels = nullptr;
+
+  s_Data.Tris.Clear();
+  s_Data.TileCounts.Clear();
+  s_Data.TileOffsets.Clear();
+  s_Data.TileTris.Clear();
+}
+
+void LilRasterizer::Begin()
+{
+  Lil::BeginFrame();
+}
+
+void LilRasterizer::End()
+{
+  LIL_PROFILE_SCOPE("LilRasterizer::End");
+  Lil::RenderFrame();
+  UpdateFontTexture(Lil::GetContext().ActiveFont);
+
+  // 1) Set up and count every triangle per tile
+  s_Data.Tris.Shrink(0);
+  for (auto& count : s_Data.TileCounts)
+    count = 0;
+
+  for (auto& drawList : Lil::GetDrawLists())
+    RasterizeDrawList(drawList);
+
+  // 2) Turn the counts into offsets and fill the bins in submission order
+  LilU32 offset = 0;
+  for (std::size_t i = 0; i < s_Data.TileCounts.GetSize(); ++i)
+  {
+    s_Data.TileOffsets[i] = offset;
+    offset += s_Data.TileCounts[i];
+    s_Data.TileCounts[i] = s_Data.TileOffsets[i];
+  }
+  s_Data.TileTris.Resize(offset);
+
+  for (std::size_t i = 0; i < s_Data.Tris.GetSize(); ++i)
+  {
+    const LilRasterTri& tri = s_Data.Tris[i];
+    for (int ty = tri.MinY / s_TileSize; ty <= (tri.MaxY - 1) / s_TileSize; ++ty)
+      for (int tx = tri.MinX / s_TileSize; tx <= (tri.MaxX - 1) / s_TileSize; ++tx)
+        s_Data.TileTris[s_Data.TileCounts[ty * s_Data.TilesX + tx]++] = static_cast<LilU32>(i);
+  }
+
+  // 3) Rasterize each tile
+  LIL_PROFILE_SCOPE("LilRasterizer::RasterizeTiles");
+  for (int ty = 0; ty < s_Data.TilesY; ++ty)
+    for (int tx = 0; tx < s_Data.TilesX; ++tx)
+      RasterizeTile(tx, ty);
+}
+
+void LilRasterizer::OnResize(int width, int height)
+{
+  width = LilMax(width, 1);
+  height = LilMax(height, 1);
+
+  operator delete(s_Data.Pixels);
+
+  s_Data.Width = width;
+  s_Data.Height = height;
+  s_Data.Stride = (width + 3) & ~3; // Pad rows so four pixel groups never run off the end of a row
+  s_Data.Pixels = static_cast<LilU32*>(operator new(static_cast<std::size_t>(s_Data.Stride) * height * sizeof(LilU32)));
+
+  s_Data.TilesX = (width + s_TileSize - 1) / s_TileSize;
+  s_Data.TilesY = (height + s_TileSize - 1) / s_TileSize;
+  s_Data.TileCounts.Resize(s_Data.TilesX * s_Data.TilesY);
+  s_Data.TileOffsets.Resize(s_Data.TilesX * s_Data.TilesY);
+
+  Clear(0);
+}
+
+void LilRasterizer::Clear(LilU32 color)
+{
+  std::size_t count = static_cast<std::size_t>(s_Data.Stride) * s_Data.Height;
+  for (std::size_t i = 0; i < count; ++i)
+    s_Data.Pixels[i] = color;
+}
+
+const LilU32* LilRasterizer::GetPixels()
+{
+  return s_Data.Pixels;
+}
+
+int LilRasterizer::GetWidth()
+{
+  return s_Data.Width;
+}
+
+int LilRasterizer::GetHeight()
+{
+  return s_Data.Height;
+}
+
+int LilRasterizer::GetStride()
+{
+  return s_Data.Stride;
+}
+
+bool LilRasterizer::SaveTGA(const char* path)
+{
+  FILE* file = std::fopen(path, "wb");
+  if (!file)
+    return false;
+
+  // Uncompressed true-color image with 8 alpha bits and a top-left origin
+  unsigned char header[18] = {};
+  header[2] = 2;
+  header[12] = static_cast<unsigned char>(s_Data.Width & 0xff);
+  header[13] = static_cast<unsigned char>(s_Data.Width >> 8);
+  header[14] = static_cast<unsigned char>(s_Data.Height & 0xff);
+  header[15] = static_cast<unsigned char>(s_Data.Height >> 8);
+  header[16] = 32;
+  header[17] = 0x28;
+  std::fwrite(header, 1, sizeof(header), file);
+
+  LilArray<unsigned char> row(s_Data.Width * 4);
+  row.Resize(s_Data.Width * 4);
+  for (int y = 0; y < s_Data.Height; ++y)
+  {
+    const LilU32* src = s_Data.Pixels + static_cast<std::size_t>(y) * s_Data.Stride;
+    for (int x = 0; x < s_Data.Width; ++x)
+    {
+      row[x * 4 + 0] = static_cast<unsigned char>(src[x] >> 16); // TGA stores BGRA
+      row[x * 4 + 1] = static_cast<unsigned char>(src[x] >> 8);
+      row[x * 4 + 2] = static_cast<unsigned char>(src[x]);
+      row[x * 4 + 3] = static_cast<unsigned char>(src[x] >> 24);
+    }
+    std::fwrite(&row[0], 1, row.GetSize(), file);
+  }
+
+  return std::fclose(file) == 0;
+}
+
+LilU32 LilRasterizer::CreateTexture(int width, int height, const LilU32* pixels)
+{
+  LilRasterTexture texture;
+  texture.Width = LilMax(width, 1);
+  texture.Height = LilMax(height, 1);
+  texture.DistanceRange = 0.0f;
+  texture.Pixels = static_cast<LilU32*>(operator new(static_cast<std::size_t>(texture.Width) * texture.Height * sizeof(LilU32)));
+
+  for (int i = 0; i < texture.Width * texture.Height; ++i)
+    texture.Pixels[i] = pixels ? pixels[i] : 0xffffffff;
+
+  // Reuse a destroyed slot when possible so IDs stay small
+  for (std::size_t i = 0; i < s_Data.Textures.GetSize(); ++i)
+  {
+    if (!s_Data.Textures[i].Pixels)
+    {
+      s_Data.Textures[i] = texture;
+      return static_cast<LilU32>(i + 1);
+    }
+  }
+
+  s_Data.Textures.PushBack(texture);
+  return static_cast<LilU32>(s_Data.Textures.GetSize());
+}
+
+void LilRasterizer::DestroyTexture(LilU32 textureID)
+{
+  if (textureID == 0 || textureID > s_Data.Textures.GetSize())
+    return;
+
+  LilRasterTexture& texture = s_Data.Textures[textureID - 1];
+  operator delete(texture.Pixels);
+  texture.Pixels = nullptr;
+}
+
+void LilRasterizer::RasterizeDrawList(const LilDrawList& drawList)
+{
+  LIL_PROFILE_SCOPE("LilRasterizer::RasterizeDrawList");
+
+  const LilArray<LilIdx>& idx = drawList.IdxArray;
+
+  for (auto& command : drawList.DrawCmds)
+  {
+    // Pixels whose centers lie inside the clip rect (NDC y points up, rows go down)
+    const LilVec4& clip = command.ClipRect;
+    s_Data.ClipMinX = LilMax(static_cast<int>(std::ceil(std::fmax((clip.x * 0.5f + 0.5f) * s_Data.Width, -1.0f) - 0.5f)), 0);
+    s_Data.ClipMaxX = LilMin(static_cast<int>(std::ceil(std::fmin((clip.z * 0.5f + 0.5f) * s_Data.Width, s_Data.Width + 1.0f) - 0.5f)), s_Data.Width);
+    s_Data.ClipMinY = LilMax(static_cast<int>(std::ceil(std::fmax((0.5f - clip.w * 0.5f) * s_Data.Height, -1.0f) - 0.5f)), 0);
+    s_Data.ClipMaxY = LilMin(static_cast<int>(std::ceil(std::fmin((0.5f - clip.y * 0.5f) * s_Data.Height, s_Data.Height + 1.0f) - 0.5f)), s_Data.Height);
+
+    // Instance-only commands may come from a list without a single vertex (null storage), so the
+    // vertex pointer is only formed for commands that draw triangles
+    const LilVtx* vtx = command.Size ? drawList.VtxArray.begin() + command.VtxOffset : nullptr;
+    const LilU32 end = command.IdxOffset + command.Size;
+
+    // Quad-indexed lists have no indices; every four vertices form a (0, 1, 2)(0, 2, 3) quad
+    if (drawList.Flags & LilDrawListFlags_QuadIndexing)
+    {
+      for (LilU32 quad = command.IdxOffset / 6; quad < end / 6; ++quad)
+      {
+        const LilVtx* q = vtx + quad * 4;
+        if (!BinRect(q[0], q[1], q[2], q[3], command.TextureID))
+        {
+          BinTriangle(q[0], q[1], q[2], command.TextureID);
+          BinTriangle(q[0], q[2], q[3], command.TextureID);
+        }
+      }
+    }
+
+    for (LilU32 i = command.IdxOffset; i + 2 < end && !(drawList.Flags & LilDrawListFlags_QuadIndexing); i += 3)
+    {
+      // Quads emitted as (a, b, c)(a, c, d) that turn out axis-aligned skip the edge functions entirely
+      if (i + 5 < end && idx[i + 3] == idx[i] && idx[i + 4] == idx[i + 2] &&
+          BinRect(vtx[idx[i]], vtx[idx[i + 1]], vtx[idx[i + 2]], vtx[idx[i + 5]], command.TextureID))
+      {
+        i += 3;
+        continue;
+      }
+
+      BinTriangle(vtx[idx[i]], vtx[idx[i + 1]], vtx[idx[i + 2]], command.TextureID);
+    }
+
+    for (LilU32 i = command.InstOffset; i < command.InstOffset + command.InstCount; ++i)
+    {
+      const LilRectInstance& rect = drawList.RectArray[i];
+      LilVec2 uvMin(rect.UV[0] / 65535.0f, rect.UV[1] / 65535.0f);
+      LilVec2 uvMax(rect.UV[2] / 65535.0f, rect.UV[3] / 65535.0f);
+
+      BinRect(LilVtx(LilVec3(rect.Min.x, rect.Min.y, 0.0f), LilVec2(uvMin.x, uvMin.y), rect.Color),
+              LilVtx(LilVec3(rect.Max.x, rect.Min.y, 0.0f), LilVec2(uvMax.x, uvMin.y), rect.Color),
+              LilVtx(LilVec3(rect.Max.x, rect.Max.y, 0.0f), LilVec2(uvMax.x, uvMax.y), rect.Color),
+              LilVtx(LilVec3(rect.Min.x, rect.Max.y, 0.0f), LilVec2(uvMin.x, uvMax.y), rect.Color),
+              rect.TextureID);
+    }
+  }
+}
+
+static inline void ToScreen(const LilVtx& vtx, float& x, float& y, int width, int height)
+{
+  // Map NDC to pixels (row 0 is the top of the framebuffer)
+  LilVec2 pos = vtx.GetPos();
+  x = (pos.x * 0.5f + 0.5f) * width;
+  y = (0.5f - pos.y * 0.5f) * height;
+}
+
+void LilRasterizer::BinTriangle(const LilVtx& v0, const LilVtx& v1, const LilVtx& v2, LilU32 textureID)
+{
+  const LilVtx* vtx[3] = { &v0, &v1, &v2 };
+
+  // 1) Screen positions with a positive area (both windings are drawn since GL culling is off)
+  float xs[3], ys[3];
+  for (int i = 0; i < 3; ++i)
+    ToScreen(*vtx[i], xs[i], ys[i], s_Data.Width, s_Data.Height);
+
+  float area = (xs[1] - xs[0]) * (ys[2] - ys[0]) - (xs[2] - xs[0]) * (ys[1] - ys[0]);
+  if (area == 0.0f || std::isnan(area))
+    return;
+
+  if (area < 0.0f)
+  {
+    float tmp = xs[1]; xs[1] = xs[2]; xs[2] = tmp;
+    tmp = ys[1]; ys[1] = ys[2]; ys[2] = tmp;
+    const LilVtx* tmpVtx = vtx[1]; vtx[1] = vtx[2]; vtx[2] = tmpVtx;
+    area = -area;
+  }
+
+  // 2) Bounds of the covered pixel centers
+  LilRasterTri tri;
+  tri.MinX = LilMax(static_cast<int>(std::ceil(std::fmin(xs[0], std::fmin(xs[1], xs[2])) - 0.5f)), s_Data.ClipMinX);
+  tri.MinY = LilMax(static_cast<int>(std::ceil(std::fmin(ys[0], std::fmin(ys[1], ys[2])) - 0.5f)), s_Data.ClipMinY);
+  tri.MaxX = LilMin(static_cast<int>(std::floor(std::fmax(xs[0], std::fmax(xs[1], xs[2])) - 0.5f)) + 1, s_Data.ClipMaxX);
+  tri.MaxY = LilMin(static_cast<int>(std::floor(std::fmax(ys[0], std::fmax(ys[1], ys[2])) - 0.5f)) + 1, s_Data.ClipMaxY);
+  if (tri.MinX >= tri.MaxX || tri.MinY >= tri.MaxY)
+    return;
+
+  // 3) Edge functions evaluated at pixel centers; the bias implements the top-left fill rule
+  for (int edge = 0; edge < 3; ++edge)
+  {
+    int a = (edge + 1) % 3;
+    int b = (edge + 2) % 3;
+
+    tri.EdgeA[edge] = ys[a] - ys[b];
+    tri.EdgeB[edge] = xs[b] - xs[a];
+    tri.EdgeC[edge] = xs[a] * ys[b] - ys[a] * xs[b] + 0.5f * (tri.EdgeA[edge] + tri.EdgeB[edge]);
+
+    bool topLeft = tri.EdgeA[edge] > 0.0f || (tri.EdgeA[edge] == 0.0f && tri.EdgeB[edge] > 0.0f);
+    tri.EdgeBias[edge] = topLeft ? -1e-30f : 0.0f;
+  }
+
+  tri.Rect = false;
+  SetupShading(tri, vtx, xs, ys, area, textureID);
+}
+
+bool LilRasterizer::BinRect(const LilVtx& v0, const LilVtx& v1, const LilVtx& v2, const LilVtx& v3, LilU32 textureID)
+{
+  const LilVtx* vtx[4] = { &v0, &v1, &v2, &v3 };
+  float xs[4], ys[4];
+  for (int i = 0; i < 4; ++i)
+    ToScreen(*vtx[i], xs[i], ys[i], s_Data.Width, s_Data.Height);
+
+  // Corners must alternate along x and y, share one color and carry affine UVs
+  bool aligned = (xs[0] == xs[3] && xs[1] == xs[2] && ys[0] == ys[1] && ys[2] == ys[3]) ||
+                 (xs[0] == xs[1] && xs[2] == xs[3] && ys[1] == ys[2] && ys[0] == ys[3]);
+  bool uniform = v0.Color == v1.Color && v0.Color == v2.Color && v0.Color == v3.Color;
+  LilVec2 uvs[4] = { v0.GetUV(), v1.GetUV(), v2.GetUV(), v3.GetUV() };
+  bool affine = std::fabs(uvs[0].x + uvs[2].x - uvs[1].x - uvs[3].x) < 1e-6f &&
+                std::fabs(uvs[0].y + uvs[2].y - uvs[1].y - uvs[3].y) < 1e-6f;
+  if (!aligned || !uniform || !affine)
+    return false;
+
+  float area = (xs[1] - xs[0]) * (ys[2] - ys[0]) - (xs[2] - xs[0]) * (ys[1] - ys[0]);
+  if (area == 0.0f || std::isnan(area))
+    return true;
+
+  // Same fill rule as the triangles: left and top edges are inclusive
+  LilRasterTri tri;
+  tri.MinX = LilMax(static_cast<int>(std::ceil(std::fmin(xs[0], xs[2]) - 0.5f)), s_Data.ClipMinX);
+  tri.MinY = LilMax(static_cast<int>(std::ceil(std::fmin(ys[0], ys[2]) - 0.5f)), s_Data.ClipMinY);
+  tri.MaxX = LilMin(static_cast<int>(std::ceil(std::fmax(xs[0], xs[2]) - 0.5f)), s_Data.ClipMaxX);
+  tri.MaxY = LilMin(static_cast<int>(std::ceil(std::fmax(ys[0], ys[2]) - 0.5f)), s_Data.ClipMaxY);
+  if (tri.MinX >= tri.MaxX || tri.MinY >= tri.MaxY)
+    return true;
+
+  tri.Rect = true;
+  SetupShading(tri, vtx, xs, ys, area, textureID);
+  return true;
+}
+
+void LilRasterizer::SetupShading(LilRasterTri& tri, const LilVtx* const* vtx, const float* xs, const float* ys, float area, LilU32 textureID)
+{
+  // 1) Attribute planes from the first three vertices
+  float values[6][3];
+  for (int i = 0; i < 3; ++i)
+  {
+    LilU32 color = vtx[i]->Color;
+    values[0][i] = static_cast<float>(color & 0xff) / 255.0f;
+    values[1][i] = static_cast<float>((color >> 8) & 0xff) / 255.0f;
+    values[2][i] = static_cast<float>((color >> 16) & 0xff) / 255.0f;
+    values[3][i] = static_cast<float>(color >> 24) / 255.0f;
+    LilVec2 uv = vtx[i]->GetUV();
+    values[4][i] = uv.x;
+    values[5][i] = uv.y;
+  }
+
+  for (int p = 0; p < 6; ++p)
+  {
+    float d1 = values[p][1] - values[p][0];
+    float d2 = values[p][2] - values[p][0];
+    float ddx = (d1 * (ys[2] - ys[0]) - d2 * (ys[1] - ys[0])) / area;
+    float ddy = (d2 * (xs[1] - xs[0]) - d1 * (xs[2] - xs[0])) / area;
+
+    tri.Planes[p][0] = ddx;
+    tri.Planes[p][1] = ddy;
+    tri.Planes[p][2] = values[p][0] - ddx * xs[0] - ddy * ys[0] + 0.5f * (ddx + ddy);
+  }
+
+  bool validTexture = textureID != 0 && textureID <= s_Data.Textures.GetSize() && s_Data.Textures[textureID - 1].Pixels;
+  tri.TextureID = validTexture ? textureID : 0;
+  tri.DistanceScale = 0.0f;
+  if (validTexture && s_Data.Textures[textureID - 1].DistanceRange > 0.0f)
+  {
+    // Same as the distance field shader: half the field's range measured in screen pixels along u and v
+    const LilRasterTexture& texture = s_Data.Textures[textureID - 1];
+    const float du = std::fabs(tri.Planes[4][0]) + std::fabs(tri.Planes[4][1]);
+    const float dv = std::fabs(tri.Planes[5][0]) + std::fabs(tri.Planes[5][1]);
+    const float screenU = du > 0.0f ? texture.DistanceRange / (texture.Width * du) : 0.0f;
+    const float screenV = dv > 0.0f ? texture.DistanceRange / (texture.Height * dv) : 0.0f;
+    tri.DistanceScale = LilMax(0.5f * (screenU + screenV), 1.0f);
+  }
+  tri.Color = vtx[0]->Color;
+  tri.Flat = !validTexture && vtx[0]->Color == vtx[1]->Color && vtx[0]->Color == vtx[2]->Color;
+
+  if (tri.Flat && (tri.Color >> 24) == 0)
+    return;
+
+  // 2) Count the tiles it touches
+  for (int ty = tri.MinY / s_TileSize; ty <= (tri.MaxY - 1) / s_TileSize; ++ty)
+    for (int tx = tri.MinX / s_TileSize; tx <= (tri.MaxX - 1) / s_TileSize; ++tx)
+      s_Data.TileCounts[ty * s_Data.TilesX + tx]++;
+
+  s_Data.Tris.PushBack(tri);
+}
+
+// Bilinear, clamped sample of a distance field stored in the texels' alpha
+static float SampleDistance(const LilU32* texels, int texWidth, int texHeight, float u, float v)
+{
+  const float fx = LilMin(LilMax(u * texWidth - 0.5f, 0.0f), static_cast<float>(texWidth - 1));
+  const float fy = LilMin(LilMax(v * texHeight - 0.5f, 0.0f), static_cast<float>(texHeight - 1));
+  const int x0 = static_cast<int>(fx);
+  const int y0 = static_cast<int>(fy);
+  const int x1 = LilMin(x0 + 1, texWidth - 1);
+  const int y1 = LilMin(y0 + 1, texHeight - 1);
+  const float tx = fx - x0;
+  const float ty = fy - y0;
+
+  const LilU32* row0 = texels + static_cast<std::size_t>(y0) * texWidth;
+  const LilU32* row1 = texels + static_cast<std::size_t>(y1) * texWidth;
+  const float top = static_cast<float>(row0[x0] >> 24) * (1.0f - tx) + static_cast<float>(row0[x1] >> 24) * tx;
+  const float bottom = static_cast<float>(row1[x0] >> 24) * (1.0f - tx) + static_cast<float>(row1[x1] >> 24) * tx;
+  return (top * (1.0f - ty) + bottom * ty) / 255.0f;
+}
+
+// Interpolates color and UV at a pixel, samples the texture (nearest, repeat) and modulates.
+// Distance field textures instead scale the alpha by the coverage of the distance they sample.
+static LilU32 ShadePixel(const float planes[6][3], const LilU32* texels, int texWidth, int texHeight, float distanceScale, int x, int y)
+{
+  float fx = static_cast<float>(x);
+  float fy = static_cast<float>(y);
+  float channels[4];
+  for (int c = 0; c < 4; ++c)
+    channels[c] = planes[c][0] * fx + planes[c][1] * fy + planes[c][2];
+
+  if (texels && distanceScale > 0.0f)
+  {
+    float u = planes[4][0] * fx + planes[4][1] * fy + planes[4][2];
+    float v = planes[5][0] * fx + planes[5][1] * fy + planes[5][2];
+    float coverage = distanceScale * (SampleDistance(texels, texWidth, texHeight, u, v) - 0.5f) + 0.5f;
+    channels[3] *= LilMin(LilMax(coverage, 0.0f), 1.0f);
+  }
+  else if (texels)
+  {
+    float u = planes[4][0] * fx + planes[4][1] * fy + planes[4][2];
+    float v = planes[5][0] * fx + planes[5][1] * fy + planes[5][2];
+
+    int tx = static_cast<int>(std::floor(u * texWidth)) % texWidth;
+    int ty = static_cast<int>(std::floor(v * texHeight)) % texHeight;
+    tx += tx < 0 ? texWidth : 0;
+    ty += ty < 0 ? texHeight : 0;
+
+    LilU32 texel = texels[ty * texWidth + tx];
+    for (int c = 0; c < 4; ++c)
+      channels[c] *= static_cast<float>((texel >> (c * 8)) & 0xff) / 255.0f;
+  }
+
+  return PackChannel(channels[0], 0) | PackChannel(channels[1], 8) | PackChannel(channels[2], 16) | PackChannel(channels[3], 24);
+}
+
+void LilRasterizer::RasterizeTile(int tileX, int tileY)
+{
+  const int tileIndex = tileY * s_Data.TilesX + tileX;
+  const LilU32 begin = s_Data.TileOffsets[tileIndex];
+  const LilU32 end = s_Data.TileCounts[tileIndex];
+
+  const int tileMinX = tileX * s_TileSize;
+  const int tileMinY = tileY * s_TileSize;
+  const int tileMaxX = LilMin(tileMinX + s_TileSize, s_Data.Width);
+  const int tileMaxY = LilMin(tileMinY + s_TileSize, s_Data.Height);
+
+  // Stores through __m128i may alias anything, so keep the framebuffer in locals
+  LilU32* const pixels = s_Data.Pixels;
+  const std::size_t stride = static_cast<std::size_t>(s_Data.Stride);
+
+  for (LilU32 t = begin; t < end; ++t)
+  {
+    const LilRasterTri& tri = s_Data.Tris[s_Data.TileTris[t]];
+
+    // Work in groups of four pixels. Lanes outside a triangle fail its edge tests and lanes
+    // outside its (possibly scissored) span are masked, which is all rects need.
+    const int spanX0 = LilMax(tri.MinX, tileMinX);
+    const int spanX1 = LilMin(tri.MaxX, tileMaxX);
+    const int x0 = spanX0 & ~3;
+    const int x1 = (spanX1 + 3) & ~3;
+    const int y0 = LilMax(tri.MinY, tileMinY);
+    const int y1 = LilMin(tri.MaxY, tileMaxY);
+    if (x0 >= x1 || y0 >= y1)
+      continue;
+
+    const bool edgeTests = !tri.Rect && !IsRegionCovered(tri.EdgeA, tri.EdgeB, tri.EdgeC, tri.EdgeBias, x0, y0, x1, y1);
+    const bool flat = tri.Flat;
+    const bool opaque = flat && (tri.Color >> 24) == 0xff;
+
+    const LilU32* texels = nullptr;
+    int texWidth = 1, texHeight = 1;
+    if (tri.TextureID)
+    {
+      const LilRasterTexture& texture = s_Data.Textures[tri.TextureID - 1];
+      texels = texture.Pixels;
+      texWidth = texture.Width;
+      texHeight = texture.Height;
+    }
+
+#ifdef LIL_RASTER_SSE2
+    const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i spanMin = _mm_set1_epi32(spanX0 - 1);
+    const __m128i spanMax = _mm_set1_epi32(spanX1);
+    const __m128 laneX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x0)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+
+    // Flat colors are premultiplied once: dst = (color * alpha + 128 + dst * (255 - alpha)) / 255
+    const __m128i color = _mm_set1_epi32(static_cast<int>(tri.Color));
+    const __m128i color16 = _mm_unpacklo_epi8(color, _mm_setzero_si128());
+    const __m128i alpha16 = _mm_set1_epi16(static_cast<short>(tri.Color >> 24));
+    const __m128i premul = _mm_add_epi16(_mm_mullo_epi16(color16, alpha16), _mm_set1_epi16(128));
+    const __m128i invAlpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha16);
+
+    __m128 edgeStep[3], edgeRowStep[3], edgeBias[3], edgeRow[3];
+    for (int e = 0; e < 3; ++e)
+    {
+      edgeStep[e] = _mm_set1_ps(4.0f * tri.EdgeA[e]);
+      edgeRowStep[e] = _mm_set1_ps(tri.EdgeB[e]);
+      edgeBias[e] = _mm_set1_ps(tri.EdgeBias[e]);
+      edgeRow[e] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.EdgeA[e]), laneX), _mm_set1_ps(tri.EdgeB[e] * y0 + tri.EdgeC[e]));
+    }
+
+    for (int y = y0; y < y1; ++y)
+    {
+      LilU32* row = pixels + y * stride;
+      __m128 e0 = edgeRow[0], e1 = edgeRow[1], e2 = edgeRow[2];
+
+      for (int x = x0; x < x1; x += 4)
+      {
+        __m128i mask;
+        if (edgeTests)
+        {
+          __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(e0, edgeBias[0]), _mm_cmpgt_ps(e1, edgeBias[1])), _mm_cmpgt_ps(e2, edgeBias[2]));
+          e0 = _mm_add_ps(e0, edgeStep[0]);
+          e1 = _mm_add_ps(e1, edgeStep[1]);
+          e2 = _mm_add_ps(e2, edgeStep[2]);
+
+          if (_mm_movemask_ps(inside) == 0)
+            continue;
+          mask = _mm_castps_si128(inside);
+        }
+        else
+        {
+          mask = _mm_set1_epi32(-1);
+        }
+
+        __m128i lanes = _mm_add_epi32(_mm_set1_epi32(x), laneOffsets);
+        mask = _mm_and_si128(mask, _mm_and_si128(_mm_cmpgt_epi32(lanes, spanMin), _mm_cmplt_epi32(lanes, spanMax)));
+
+        __m128i* dstPtr = reinterpret_cast<__m128i*>(row + x);
+        __m128i dst = _mm_loadu_si128(dstPtr);
+        __m128i src;
+
+        if (opaque)
+          src = color;
+        else if (flat)
+        {
+          __m128i lo = _mm_add_epi16(premul, _mm_mullo_epi16(_mm_unpacklo_epi8(dst, _mm_setzero_si128()), invAlpha));
+          __m128i hi = _mm_add_epi16(premul, _mm_mullo_epi16(_mm_unpackhi_epi8(dst, _mm_setzero_si128()), invAlpha));
+          lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+          hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+          src = _mm_packus_epi16(lo, hi);
+        }
+        else
+        {
+          alignas(16) LilU32 shaded[4];
+          for (int lane = 0; lane < 4; ++lane)
+            shaded[lane] = ShadePixel(tri.Planes, texels, texWidth, texHeight, tri.DistanceScale, x + lane, y);
+          src = BlendPixels4(_mm_load_si128(reinterpret_cast<const __m128i*>(shaded)), dst);
+        }
+
+        _mm_storeu_si128(dstPtr, SelectPixels4(mask, src, dst));
+      }
+
+      for (int e = 0; e < 3; ++e)
+        edgeRow[e] = _mm_add_ps(edgeRow[e], edgeRowStep[e]);
+    }
+#else
+    for (int y = y0; y < y1; ++y)
+    {
+      LilU32* row = pixels + y * stride;
+      for (int x = spanX0; x < spanX1; ++x)
+      {
+        bool inside = true;
+        for (int e = 0; e < 3 && edgeTests; ++e)
+          inside = inside && tri.EdgeA[e] * x + tri.EdgeB[e] * y + tri.EdgeC[e] > tri.EdgeBias[e];
+        if (!inside)
+          continue;
+
+        if (opaque)
+          row[x] = tri.Color;
+        else if (flat)
+          row[x] = BlendPixel(tri.Color, row[x]);
+        else
+          row[x] = BlendPixel(ShadePixel(tri.Planes, texels, texWidth, texHeight, tri.DistanceScale, x, y), row[x]);
+      }
+    }
+#endif
+  }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "lilGUI.h"
+
+/*
+--------------------------------------------------
+----- SECTION (LilRasterizer) --------------------
+--------------------------------------------------
+
+LilRasterizer is a headless backend that consumes the same
+LilDrawList data as the OpenGL renderer and rasterizes it
+on the CPU into an RGBA8 framebuffer (same byte order as
+LilU32 colors). It needs no GPU or window, which makes it
+useful for screenshots and frame-time benchmarks on CI.
+
+The framebuffer is split into tiles. Every triangle of the
+frame is binned into the tiles it touches (in submission
+order, so blending stays correct) and each tile is then
+filled with SSE2 edge functions, four pixels per step.
+Texture sampling and blending match LilRenderer::Init
+(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).
+
+LilDrawCmd::ClipRect is applied as a scissor box, snapped to
+pixel centers the same way the OpenGL renderer snaps it.
+
+Texture ID 0 is an implicit white texture, just like the
+OpenGL renderer binds by default. The active font's A8 atlas
+is expanded to white RGBA8 texels with the coverage as alpha,
+which is what the OpenGL renderer's swizzle samples as. Glyph
+cache updates are copied in as sub-rects at End.
+
+A distance field font (LilFont::DistanceRange > 0) is sampled
+bilinearly and its distance turned into coverage over the
+field's range in screen pixels, like the OpenGL renderer's
+distance field shader.
+
+-- TODO --
+1) Rasterize tiles on multiple threads.
+*/
+
+class LilRasterizer
+{
+public:
+  static void Init(int width, int height);
+  static void Terminate();
+
+  static void Begin();
+  static void End();
+
+  static void OnResize(int width, int height);
+  static void Clear(LilU32 color);
+
+  // Pixels are RGBA8 rows of GetStride() pixels (stride >= width)
+  static const LilU32* GetPixels();
+  static int GetWidth();
+  static int GetHeight();
+  static int GetStride();
+  static bool SaveTGA(const char* path);
+
+  // Pixels are tightly packed RGBA8 rows; returns a non-zero ID to store in LilDrawCmd::TextureID
+  static LilU32 CreateTexture(int width, int height, const LilU32* pixels);
+  static void DestroyTexture(LilU32 textureID);
+
+private:
+  struct LilRasterTri
+  {
+    int MinX, MinY, MaxX, MaxY; // Pixel bounds, max is exclusive
+    float EdgeA[3], EdgeB[3], EdgeC[3], EdgeBias[3];
+    float Planes[6][3]; // R, G, B, A, U, V as (ddx, ddy, constant) at pixel centers
+    LilU32 Color; // Used when Flat is set
+    LilU32 TextureID;
+    float DistanceScale; // Screen pixels per unit of distance when the texture is a distance field, otherwise 0
+    bool Flat;
+    bool Rect; // Axis-aligned quad that covers its bounds exactly, so the edges are never tested
+  };
+
+  struct LilRasterTexture
+  {
+    LilU32* Pixels;
+    int Width, Height;
+    float DistanceRange; // Texels the alpha's 0 to 1 spans when it holds a distance field, otherwise 0
+  };
+
+  struct LilRasterizerData
+  {
+    LilU32* Pixels;
+    int Width, Height, Stride;
+    int TilesX, TilesY;
+
+    int ClipMinX, ClipMinY, ClipMaxX, ClipMaxY; // Scissor box of the command being binned, max is exclusive
+
+    LilArray<LilRasterTri> Tris;
+    LilArray<LilU32> TileCounts; // Per tile triangle count, becomes the write cursor while binning
+    LilArray<LilU32> TileOffsets;
+    LilArray<LilU32> TileTris;
+
+    LilArray<LilRasterTexture> Textures;
+    LilArray<LilAtlasRect> AtlasUpdates;
+  };
+
+  static LilRasterizerData s_Data;
+
+private:
+  static void RasterizeDrawList(const LilDrawList& drawList);
+  static void BinTriangle(const LilVtx& v0, const LilVtx& v1, const LilVtx& v2, LilU32 textureID);
+  static bool BinRect(const LilVtx& v0, const LilVtx& v1, const LilVtx& v2, const LilVtx& v3, LilU32 textureID);
+  static void SetupShading(LilRasterTri& tri, const LilVtx* const* vtx, const float* xs, const float* ys, float area, LilU32 textureID);
+  static void RasterizeTile(int tileX, int tileY);
+  static void UpdateFontTexture(LilFont& font);
+};
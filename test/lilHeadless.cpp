@@ -0,0 +1,175 @@
+#include "lilRenderer.h"
+
+#include <lilGUI.h>
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+--------------------------------------------------
+----- SECTION (LilHeadless) ----------------------
+--------------------------------------------------
+
+Runs LilRenderer without a window: an EGL context (surfaceless
+where Mesa offers it, so llvmpipe works on CI machines without
+a display) renders into an offscreen framebuffer for a number
+of frames, once with the persistently mapped ring and once with
+the unsynchronized map fallback. After each run it prints the
+renderer stats (PersistentMapping, FenceWaits, FenceStalls, ...)
+and checks one pixel of the frame, so a broken upload path
+shows up as a wrong color, not only as odd counters.
+
+Usage: lilHeadless [frames]   (default 300)
+The exit status is non-zero when no context could be created or
+a pixel check failed.
+*/
+
+static constexpr int s_Width = 800, s_Height = 600;
+
+static EGLDisplay GetHeadlessDisplay()
+{
+  // Surfaceless needs neither X11 nor a GPU, otherwise fall back to whatever the default display is
+  const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless"))
+  {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay)
+    {
+      EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+        return display;
+    }
+  }
+  
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+    return display;
+  return EGL_NO_DISPLAY;
+}
+
+static EGLContext CreateHeadlessContext(EGLDisplay display)
+{
+  // Any surface type: the default (window) matches no config on a surfaceless display
+  const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_SURFACE_TYPE, 0, EGL_NONE };
+  EGLConfig config;
+  EGLint configCount = 0;
+  if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0)
+    return EGL_NO_CONTEXT;
+  
+  const EGLint contextAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+  if (context == EGL_NO_CONTEXT)
+    return EGL_NO_CONTEXT;
+  
+  // No surface at all (EGL_KHR_surfaceless_context), the frames go to a framebuffer object
+  if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+  {
+    eglDestroyContext(display, context);
+    return EGL_NO_CONTEXT;
+  }
+  return context;
+}
+
+// Renders frames through LilRenderer and returns whether the red rect came out red
+static bool RunFrames(GLADloadproc loadProc, int frames)
+{
+  LilRenderer::Init(loadProc);
+  LilRenderer::OnResize(static_cast<float>(s_Width), static_cast<float>(s_Height));
+  
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+  
+    LilRenderer::Begin();
+  
+    // Enough geometry per frame for every ring segment to be reused while the GPU may still read it
+    Lil::Rect(0.0f, 0.0f, 0.5f, 0.5f, 0xff0000ff);
+    for (int i = 0; i < 2000; ++i)
+    {
+      const float x = -1.0f + (i % 50) * 0.02f, y = -1.0f + (i / 50) * 0.02f;
+      Lil::Rect(x, y, 0.015f, 0.015f, 0xff000000 | static_cast<LilU32>(i * 2654435761u >> 8));
+    }
+    Lil::Text(-0.9f, 0.9f, "lilGUI headless", 0.08f);
+  
+    LilRenderer::End();
+    glFlush();
+  }
+  
+  // Center of the red rect, which nothing else draws over
+  unsigned char pixel[4] = {};
+  glReadPixels(s_Width * 5 / 8, s_Height * 5 / 8, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+  const bool red = pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 0;
+  
+  const LilRendererStats& stats = LilRenderer::GetStats();
+  std::printf("path=%s frames=%d persistent=%d fence_waits=%u fence_stalls=%u buffer_growths=%u state_calls=%u state_calls_skipped=%u pixel=%s\n",
+              loadProc ? "persistent" : "fallback", frames, stats.PersistentMapping ? 1 : 0, stats.FenceWaits, stats.FenceStalls,
+              stats.BufferGrowths, stats.StateCalls, stats.StateCallsSkipped, red ? "ok" : "wrong");
+  
+  LilRenderer::Terminate();
+  return red;
+}
+
+int main(int argc, char** argv)
+{
+  const int frames = argc > 1 ? std::atoi(argv[1]) : 300;
+  
+  // 1) Create an EGL context without any window
+  EGLDisplay display = GetHeadlessDisplay();
+  if (display == EGL_NO_DISPLAY)
+  {
+    std::fprintf(stderr, "No EGL display\n");
+    return 1;
+  }
+  
+  EGLContext context = CreateHeadlessContext(display);
+  if (context == EGL_NO_CONTEXT)
+  {
+    std::fprintf(stderr, "No GL 3.3 core context\n");
+    eglTerminate(display);
+    return 1;
+  }
+  
+  // 2) Initialize GLAD
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+  {
+    std::fprintf(stderr, "Failed to initialize GLAD\n");
+    return 1;
+  }
+  std::printf("renderer=%s version=%s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)), reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+  
+  // 3) Offscreen framebuffer the renderer draws into
+  GLuint framebuffer, colorBuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glGenRenderbuffers(1, &colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, s_Width, s_Height);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+  {
+    std::fprintf(stderr, "Incomplete framebuffer\n");
+    return 1;
+  }
+  
+  // 4) Both upload paths: the persistently mapped ring needs the loader for glBufferStorage
+  const bool persistentOk = RunFrames((GLADloadproc)eglGetProcAddress, frames);
+  const bool fallbackOk = RunFrames(nullptr, frames);
+  
+  // 5) Shut Down
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(1, &colorBuffer);
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(display, context);
+  eglTerminate(display);
+  return persistentOk && fallbackOk ? 0 : 1;
+}
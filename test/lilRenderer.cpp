@@ -1,11 +1,344 @@
 #include "lilRenderer.h"
 
 #include <lilGUI.h>
+#include <lilProfiler.h>
 //#include <iostream>
 
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
 LilRenderer::LilRendererData LilRenderer::s_Data;
 
-void LilRenderer::Init()
+static GLuint CompileProgram(const char* vertexSource, const char* fragmentSource)
+{
+  unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(vertexShader, 1, &vertexSource, nullptr);
+  glCompileShader(vertexShader);
+  
+  int success;
+  char infoLog[512];
+  glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+  if (!success)
+  {
+      glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
+      //std::cout << "Vertex Shader Failed to Compile:" << std:://endl << infoLog << std::endl;
+  }
+  
+  unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+  glCompileShader(fragmentShader);
+  
+  glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+  if (!success)
+  {
+    glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+    //std::cout << "Fragment Shader Failed to Compile:" << std::endl << infoLog << std::endl;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertexShader);
+  glAttachShader(program, fragmentShader);
+  glLinkProgram(program);
+
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success)
+  {
+    glGetProgramInfoLog(program, 512, NULL, infoLog);
+    //std::cout << "Shader Failed to Link" << infoLog << std::endl;
+  }
+  
+  glDeleteShader(vertexShader);
+  glDeleteShader(fragmentShader);
+  
+  return program;
+}
+
+// Layout of LilVtx for whichever vertex array and vertex buffer are bound
+static void SetVertexAttributes()
+{
+#ifdef LIL_COMPACT_VTX
+  glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(LilVtx), (void*)offsetof(LilVtx, Pos)); // Scaled by u_PosScale
+  glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(LilVtx), (void*)offsetof(LilVtx, UV));
+#else
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LilVtx), (void*)offsetof(LilVtx, Pos));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(LilVtx), (void*)offsetof(LilVtx, UV));
+#endif
+  glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LilVtx), (void*)offsetof(LilVtx, Color));
+  
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+}
+
+// Shadows the GL state End touches so only calls that change something reach the driver.
+// The application may change GL state between frames, so End starts every frame from Invalidate().
+class LilGLStateCache
+{
+public:
+  static constexpr GLuint Unknown = ~0u;
+  static constexpr GLuint TextureUnits = 8;
+  
+  unsigned int Issued = 0, Skipped = 0; // GL calls
+  
+  void Invalidate()
+  {
+    Program = VertexArray = ArrayBuffer = ElementBuffer = CopyWriteBuffer = ActiveUnit = Unknown;
+    for (auto& texture : Textures)
+      texture = Unknown;
+    Blend = Scissor = -1;
+    ScissorBox[0] = -1;
+  }
+  
+  void UseProgram(GLuint program)
+  {
+    if (Track(Program != program))
+      glUseProgram(Program = program);
+  }
+  
+  void BindVertexArray(GLuint vertexArray)
+  {
+    if (!Track(VertexArray != vertexArray))
+      return;
+    
+    glBindVertexArray(VertexArray = vertexArray);
+    ElementBuffer = Unknown; // Part of the vertex array's state
+  }
+  
+  void BindBuffer(GLenum target, GLuint buffer)
+  {
+    GLuint* bound = GetBinding(target);
+    if (!bound || Track(*bound != buffer))
+      glBindBuffer(target, buffer);
+    if (bound)
+      *bound = buffer;
+  }
+  
+  // Deleting a buffer unbinds it from every binding point of the context
+  void ForgetBuffer(GLuint buffer)
+  {
+    for (GLuint* bound : { &ArrayBuffer, &ElementBuffer, &CopyWriteBuffer })
+      *bound = *bound == buffer ? 0 : *bound;
+  }
+  
+  void BindTexture(GLuint unit, GLuint texture)
+  {
+    if (unit < TextureUnits && !Track(Textures[unit] != texture))
+      return;
+    
+    if (Track(ActiveUnit != unit))
+      glActiveTexture(GL_TEXTURE0 + (ActiveUnit = unit));
+    
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (unit < TextureUnits)
+      Textures[unit] = texture;
+  }
+  
+  // Blending is always GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, which the rasterizer matches
+  void SetBlend(bool enabled)
+  {
+    if (!Track(Blend != enabled, enabled ? 2 : 1))
+      return;
+    
+    Blend = enabled;
+    if (!enabled)
+    {
+      glDisable(GL_BLEND);
+      return;
+    }
+    
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+  
+  void SetScissor(bool enabled, GLint x = 0, GLint y = 0, GLsizei width = 0, GLsizei height = 0)
+  {
+    if (Track(Scissor != enabled))
+    {
+      Scissor = enabled;
+      enabled ? glEnable(GL_SCISSOR_TEST) : glDisable(GL_SCISSOR_TEST);
+    }
+    
+    if (!enabled)
+      return;
+    
+    const GLint box[4] = { x, y, width, height };
+    if (Track(std::memcmp(box, ScissorBox, sizeof(box)) != 0))
+    {
+      std::memcpy(ScissorBox, box, sizeof(box));
+      glScissor(x, y, width, height);
+    }
+  }
+  
+private:
+  GLuint Program, VertexArray, ArrayBuffer, ElementBuffer, CopyWriteBuffer, ActiveUnit;
+  GLuint Textures[TextureUnits];
+  int Blend, Scissor;
+  GLint ScissorBox[4];
+  
+  bool Track(bool changed, unsigned int calls = 1)
+  {
+    (changed ? Issued : Skipped) += calls;
+    return changed;
+  }
+  
+  GLuint* GetBinding(GLenum target)
+  {
+    switch (target)
+    {
+      case GL_ARRAY_BUFFER: return &ArrayBuffer;
+      case GL_ELEMENT_ARRAY_BUFFER: return &ElementBuffer;
+      case GL_COPY_WRITE_BUFFER: return &CopyWriteBuffer;
+      default: return nullptr;
+    }
+  }
+};
+
+static LilGLStateCache s_State;
+
+// glad only loads GL 3.3, so ARB_buffer_storage is fetched by hand in Init
+#define LIL_GL_MAP_PERSISTENT_BIT 0x0040
+#define LIL_GL_MAP_COHERENT_BIT 0x0080
+typedef void (APIENTRYP PFNLILBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+static PFNLILBUFFERSTORAGEPROC s_BufferStorage = nullptr;
+
+static bool HasBufferStorage()
+{
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major > 4 || (major == 4 && minor >= 4))
+    return true;
+  
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i)
+  {
+    const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (name && std::strcmp(name, "GL_ARB_buffer_storage") == 0)
+      return true;
+  }
+  
+  return false;
+}
+
+// Buffers are only ever bound to GL_COPY_WRITE_BUFFER here, so creating or mapping one never disturbs the vertex arrays
+void LilRenderer::CreateStreamBuffer(LilStreamBuffer& buffer, std::size_t segmentSize)
+{
+  segmentSize = (segmentSize + buffer.ElementSize - 1) / buffer.ElementSize * buffer.ElementSize;
+  buffer.SegmentSize = segmentSize ? segmentSize : buffer.ElementSize;
+  buffer.Mapped = nullptr;
+  
+  const std::size_t size = buffer.SegmentSize * FramesInFlight;
+  glGenBuffers(1, &buffer.ID);
+  s_State.BindBuffer(GL_COPY_WRITE_BUFFER, buffer.ID);
+  
+  if (s_BufferStorage)
+  {
+    const GLbitfield flags = GL_MAP_WRITE_BIT | LIL_GL_MAP_PERSISTENT_BIT | LIL_GL_MAP_COHERENT_BIT;
+    s_BufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+    buffer.Mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+  }
+  else
+  {
+    glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+  }
+  
+  s_State.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void LilRenderer::DestroyStreamBuffer(LilStreamBuffer& buffer)
+{
+  if (buffer.Mapped)
+  {
+    s_State.BindBuffer(GL_COPY_WRITE_BUFFER, buffer.ID);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    s_State.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+  
+  glDeleteBuffers(1, &buffer.ID);
+  s_State.ForgetBuffer(buffer.ID);
+  buffer.ID = 0;
+  buffer.Mapped = nullptr;
+}
+
+// Grows every segment to at least size bytes. Capacity doubles so a growing UI settles after a few frames.
+// Immutable storage can't be re-specified, so the buffer is replaced; GL keeps the old one alive for in-flight draws.
+bool LilRenderer::ReserveStreamBuffer(LilStreamBuffer& buffer, std::size_t size)
+{
+  if (size <= buffer.SegmentSize)
+    return false;
+  
+  std::size_t newSize = buffer.SegmentSize * 2;
+  while (newSize < size)
+    newSize *= 2;
+  
+  DestroyStreamBuffer(buffer);
+  CreateStreamBuffer(buffer, newSize);
+  ++s_Data.Stats.BufferGrowths;
+  return true;
+}
+
+// The segment was fenced when it was last drawn from, so neither path lets the driver synchronize for us
+char* LilRenderer::MapStreamSegment(LilStreamBuffer& buffer, unsigned int segment, std::size_t size)
+{
+  if (size == 0)
+    return nullptr;
+  
+  if (buffer.Mapped)
+    return buffer.Mapped + segment * buffer.SegmentSize;
+  
+  s_State.BindBuffer(GL_COPY_WRITE_BUFFER, buffer.ID);
+  return static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, segment * buffer.SegmentSize, size,
+                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+}
+
+void LilRenderer::UnmapStreamSegment(LilStreamBuffer& buffer, std::size_t size)
+{
+  if (size == 0 || buffer.Mapped)
+    return;
+  
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+  s_State.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Blocks until the GPU is done with the frame that last used this segment
+void LilRenderer::WaitForSegment(unsigned int segment)
+{
+  GLsync& fence = s_Data.Fences[segment];
+  if (!fence)
+    return;
+  
+  ++s_Data.Stats.FenceWaits;
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED)
+  {
+    ++s_Data.Stats.FenceStalls;
+    do
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while (result == GL_TIMEOUT_EXPIRED);
+  }
+  
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+// Both vertex arrays read the streamed vertex buffer, so they are re-pointed whenever it is replaced
+void LilRenderer::SetStreamAttributes()
+{
+  s_State.BindVertexArray(s_Data.VAO);
+  s_State.BindBuffer(GL_ARRAY_BUFFER, s_Data.Vertices.ID);
+  s_State.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_Data.Indices.ID);
+  SetVertexAttributes();
+  
+  s_State.BindVertexArray(s_Data.QuadVAO);
+  SetVertexAttributes();
+  
+  s_State.BindVertexArray(0);
+  s_State.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void LilRenderer::Init(GLADloadproc loadProc, std::size_t vertexBufferSize, std::size_t indexBufferSize)
 {
   
   // 1) Data Sources
@@ -18,13 +351,35 @@ void LilRenderer::Init()
   
   out vec4 v_Color;
   out vec2 v_UV;
+  
+  uniform float u_PosScale;
 
   void main()
   {
     v_Color = a_Color;
     v_UV = a_UV;
   
-    gl_Position = vec4(a_Pos, 1.0);
+    gl_Position = vec4(a_Pos.xy * u_PosScale, 0.0, 1.0);
+  })";
+
+  // Expands one LilRectInstance per instance into a triangle strip
+  static const char *instanceVertexSource = R"(
+  #version 330 core
+
+  layout (location = 0) in vec4 a_Rect;
+  layout (location = 1) in vec4 a_UVRect;
+  layout (location = 2) in vec4 a_Color;
+  
+  out vec4 v_Color;
+  out vec2 v_UV;
+
+  void main()
+  {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    v_Color = a_Color;
+    v_UV = mix(a_UVRect.xy, a_UVRect.zw, corner);
+  
+    gl_Position = vec4(mix(a_Rect.xy, a_Rect.zw, corner), 0.0, 1.0);
   })";
 
   static const char *fragmentSource = R"(
@@ -42,77 +397,104 @@ void LilRenderer::Init()
     FragColor = v_Color * texture(u_Texture, v_UV.xy);
   })";
 
+  // Distance field glyphs: the field's range in screen pixels turns the sampled distance into antialiased coverage
+  static const char *distanceFieldSource = R"(
+  #version 330 core
+
+  in vec4 v_Color;
+  in vec2 v_UV;
+  
+  out vec4 FragColor;
+  
+  uniform sampler2D u_Texture;
+  uniform float u_DistanceRange;
+
+  void main()
+  {
+    vec2 unitRange = vec2(u_DistanceRange) / vec2(textureSize(u_Texture, 0));
+    vec2 screenTexSize = vec2(1.0) / fwidth(v_UV);
+    float screenRange = max(0.5 * dot(unitRange, screenTexSize), 1.0);
+    float alpha = clamp(screenRange * (texture(u_Texture, v_UV).a - 0.5) + 0.5, 0.0, 1.0);
+    FragColor = vec4(v_Color.rgb, v_Color.a * alpha);
+  })";
+
   // 2) Init GL State
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   
   // 3) Compile Shaders
-  unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexShader, 1, &vertexSource, nullptr);
-  glCompileShader(vertexShader);
+  s_Data.ShaderProgram = CompileProgram(vertexSource, fragmentSource);
+  s_Data.InstanceProgram = CompileProgram(instanceVertexSource, fragmentSource);
+  s_Data.DistanceFieldProgram = CompileProgram(vertexSource, distanceFieldSource);
+  s_Data.DistanceFieldInstanceProgram = CompileProgram(instanceVertexSource, distanceFieldSource);
   
-  int success;
-  char infoLog[512];
-  glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-  if (!success)
-  {
-      glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-      //std::cout << "Vertex Shader Failed to Compile:" << std:://endl << infoLog << std::endl;
-  }
+#ifdef LIL_COMPACT_VTX
+  const float posScale = 1.0f / LilVtx::PosScale;
+#else
+  const float posScale = 1.0f;
+#endif
+  glUseProgram(s_Data.ShaderProgram);
+  glUniform1f(glGetUniformLocation(s_Data.ShaderProgram, "u_PosScale"), posScale);
+  glUseProgram(s_Data.DistanceFieldProgram);
+  glUniform1f(glGetUniformLocation(s_Data.DistanceFieldProgram, "u_PosScale"), posScale);
+  glUseProgram(0);
   
-  unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-  glCompileShader(fragmentShader);
+  // 6) Set Up Streamed Buffers (persistently mapped when ARB_buffer_storage is there)
+  s_BufferStorage = nullptr;
+  if (loadProc && HasBufferStorage())
+    s_BufferStorage = reinterpret_cast<PFNLILBUFFERSTORAGEPROC>(loadProc("glBufferStorage"));
   
-  glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-  if (!success)
-  {
-    glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-    //std::cout << "Fragment Shader Failed to Compile:" << std::endl << infoLog << std::endl;
-  }
-
-  // 4) Link Shaders
-  s_Data.ShaderProgram = glCreateProgram();
-  glAttachShader(s_Data.ShaderProgram, vertexShader);
-  glAttachShader(s_Data.ShaderProgram, fragmentShader);
-  glLinkProgram(s_Data.ShaderProgram);
-
-  glGetProgramiv(s_Data.ShaderProgram, GL_LINK_STATUS, &success);
-  if (!success)
-  {
-    glGetProgramInfoLog(s_Data.ShaderProgram, 512, NULL, infoLog);
-    //std::cout << "Shader Failed to Link" << infoLog << std::endl;
-  }
+  s_Data.Stats = LilRendererStats();
+  s_Data.Stats.PersistentMapping = s_BufferStorage != nullptr;
+  s_Data.FrameIndex = 0;
+  for (auto& fence : s_Data.Fences)
+    fence = nullptr;
   
-  // 5) Clean Up Shaders
-  glDeleteShader(vertexShader);
-  glDeleteShader(fragmentShader);
+  s_Data.Vertices.ElementSize = sizeof(LilVtx);
+  s_Data.Indices.ElementSize = sizeof(LilIdx);
+  s_Data.Instances.ElementSize = sizeof(LilRectInstance);
+  CreateStreamBuffer(s_Data.Vertices, vertexBufferSize);
+  CreateStreamBuffer(s_Data.Indices, indexBufferSize);
+  CreateStreamBuffer(s_Data.Instances, vertexBufferSize);
+  s_Data.Stats.VtxCapacity = s_Data.Vertices.SegmentSize;
+  s_Data.Stats.IdxCapacity = s_Data.Indices.SegmentSize;
+  s_Data.Stats.InstanceCapacity = s_Data.Instances.SegmentSize;
   
-  // 6) Set Up Vertex Array
+  // 7) Set Up Vertex Arrays, the quad one shares the vertices with a static 0,1,2,0,2,3 index buffer
   glGenVertexArrays(1, &s_Data.VAO);
-  glGenBuffers(1, &s_Data.VBO);
-  glGenBuffers(1, &s_Data.IBO);
+  glGenVertexArrays(1, &s_Data.QuadVAO);
+  glGenBuffers(1, &s_Data.QuadIBO);
   
-  glBindVertexArray(s_Data.VAO);
+  LilArray<unsigned short> quadIndices;
+  quadIndices.Reserve(Lil::MaxQuadsPerCmd * 6);
+  for (LilU32 quad = 0; quad < Lil::MaxQuadsPerCmd; ++quad)
+  {
+    const unsigned short base = static_cast<unsigned short>(quad * 4);
+    const unsigned short pattern[6] = { 0, 1, 2, 0, 2, 3 };
+    for (unsigned short offset : pattern)
+      quadIndices.PushBack(static_cast<unsigned short>(base + offset));
+  }
   
-  glBindBuffer(GL_ARRAY_BUFFER, s_Data.VBO);
-  glBufferData(GL_ARRAY_BUFFER, 250 * 1024, nullptr, GL_DYNAMIC_DRAW); // 250kb buffer (if we're full, the cpu is probably already dead...)
+  glBindVertexArray(s_Data.QuadVAO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_Data.QuadIBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, quadIndices.GetSize() * sizeof(unsigned short), &quadIndices[0], GL_STATIC_DRAW);
+  glBindVertexArray(0);
   
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_Data.IBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, 50 * 1024, nullptr, GL_DYNAMIC_DRAW); // 50kb buffer
+  SetStreamAttributes();
+  
+  // 8) Set Up Rect Instance Array (attribute offsets are set per draw command in End)
+  glGenVertexArrays(1, &s_Data.InstanceVAO);
+  glBindVertexArray(s_Data.InstanceVAO);
+  
+  for (GLuint attrib = 0; attrib < 3; ++attrib)
+  {
+    glEnableVertexAttribArray(attrib);
+    glVertexAttribDivisor(attrib, 1);
+  }
   
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LilVtx), (void*)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(LilVtx), (void*)sizeof(LilVec3));
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LilVtx), (void*)(sizeof(LilVec3) + sizeof(LilVec2)));
-  glEnableVertexAttribArray(2);
-
   glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
   
-  // 7) Generate Texture
+  // 9) Generate Texture
   glGenTextures(1, &s_Data.TextureID);
   glBindTexture(GL_TEXTURE_2D, s_Data.TextureID);
   
@@ -120,67 +502,266 @@ void LilRenderer::Init()
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data);
   glGenerateMipmap(GL_TEXTURE_2D); // CRUCIAL LINE ON MACOS
   
-  // 8) Create LilContext
+  // 10) Create LilContext and upload the font atlas it built
   Lil::CreateContext();
+  UpdateFontTexture(Lil::GetContext().ActiveFont);
+}
+
+void LilRenderer::UpdateFontTexture(LilFont& font)
+{
+  s_Data.AtlasUpdates.Shrink(0);
+  font.TakeAtlasUpdates(s_Data.AtlasUpdates);
+  if (!font.AtlasDirty && s_Data.AtlasUpdates.Empty())
+    return;
+  
+  // Bitmap glyphs are drawn at integer multiples of their size, where nearest sampling keeps them crisp.
+  // Distance fields are drawn at any size and need the interpolated distance between texels.
+  const GLint filter = font.DistanceRange > 0.0f ? GL_LINEAR : GL_NEAREST;
+  
+  if (!font.TextureID)
+  {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    s_State.BindTexture(0, texture);
+    
+    // Single channel coverage that samples as white with the coverage as alpha
+    const GLint swizzle[4] = { GL_ONE, GL_ONE, GL_ONE, GL_RED };
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    font.TextureID = texture;
+  }
+  
+  s_State.BindTexture(0, font.TextureID);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  
+  // A rebuilt atlas is uploaded whole, new cache glyphs only as the shelf ranges they were written to
+  if (font.AtlasDirty)
+  {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, font.AtlasWidth, font.AtlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, &font.AtlasPixels[0]);
+    font.AtlasDirty = false;
+    
+    // End picks the distance field programs for commands drawing with this texture
+    s_Data.DistanceFieldTexture = font.DistanceRange > 0.0f ? font.TextureID : 0;
+    for (GLuint program : { s_Data.DistanceFieldProgram, s_Data.DistanceFieldInstanceProgram })
+    {
+      s_State.UseProgram(program);
+      glUniform1f(glGetUniformLocation(program, "u_DistanceRange"), font.DistanceRange);
+    }
+  }
+  else
+  {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, font.AtlasWidth);
+    for (const LilAtlasRect& rect : s_Data.AtlasUpdates)
+      glTexSubImage2D(GL_TEXTURE_2D, 0, rect.X, rect.Y, rect.Width, rect.Height, GL_RED, GL_UNSIGNED_BYTE,
+                      &font.AtlasPixels[static_cast<std::size_t>(rect.Y) * font.AtlasWidth + rect.X]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  }
+  
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
 void LilRenderer::Terminate()
 {
+  LilFont& font = Lil::GetContext().ActiveFont;
+  glDeleteTextures(1, &font.TextureID);
+  font.TextureID = 0;
+  
   Lil::DestroyContext();
   
+  for (auto& fence : s_Data.Fences)
+  {
+    if (fence)
+      glDeleteSync(fence);
+    fence = nullptr;
+  }
+  
+  DestroyStreamBuffer(s_Data.Vertices);
+  DestroyStreamBuffer(s_Data.Indices);
+  DestroyStreamBuffer(s_Data.Instances);
+  
   glDeleteVertexArrays(1, &s_Data.VAO);
-  glDeleteBuffers(1, &s_Data.VBO);
-  glDeleteBuffers(1, &s_Data.IBO);
+  glDeleteVertexArrays(1, &s_Data.QuadVAO);
+  glDeleteBuffers(1, &s_Data.QuadIBO);
   glDeleteProgram(s_Data.ShaderProgram);
+  glDeleteVertexArrays(1, &s_Data.InstanceVAO);
+  glDeleteProgram(s_Data.InstanceProgram);
+  glDeleteProgram(s_Data.DistanceFieldProgram);
+  glDeleteProgram(s_Data.DistanceFieldInstanceProgram);
   glDeleteTextures(1, &s_Data.TextureID);
 }
 
+// Scissor box covering the pixels whose centers lie inside the clip rect, which is how the CPU rasterizer snaps it
+static void SetClipRect(const LilVec4& clip, const GLint* viewport)
+{
+  if (clip.x <= -1.0f && clip.y <= -1.0f && clip.z >= 1.0f && clip.w >= 1.0f)
+  {
+    s_State.SetScissor(false);
+    return;
+  }
+  
+  auto toPixel = [](float ndc, GLint size) {
+    float pixel = (ndc * 0.5f + 0.5f) * size;
+    pixel = pixel < -1.0f ? -1.0f : (pixel > size + 1.0f ? size + 1.0f : pixel);
+    return static_cast<GLint>(std::ceil(pixel - 0.5f));
+  };
+  
+  const GLint x0 = toPixel(clip.x, viewport[2]), x1 = toPixel(clip.z, viewport[2]);
+  const GLint y0 = toPixel(clip.y, viewport[3]), y1 = toPixel(clip.w, viewport[3]);
+  s_State.SetScissor(true, viewport[0] + x0, viewport[1] + y0, x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0);
+}
+
 void LilRenderer::Begin()
 {
   Lil::BeginFrame();
 }
 
+// Concatenates every draw list into one mapped segment, so a whole stream is uploaded with a single map
+template <typename T, typename Accessor>
+static void PackFrame(char* dst, Accessor getArray)
+{
+  if (!dst)
+    return;
+  
+  for (auto& drawList : Lil::GetDrawLists())
+  {
+    const LilArray<T>& array = getArray(drawList);
+    if (array.Empty())
+      continue;
+    
+    std::memcpy(dst, &array[0], array.GetSize() * sizeof(T));
+    dst += array.GetSize() * sizeof(T);
+  }
+}
+
 void LilRenderer::End()
 {
+  LIL_PROFILE_SCOPE("LilRenderer::End");
   Lil::RenderFrame();
   
+  s_State.Invalidate();
+  s_State.Issued = s_State.Skipped = 0;
+  
+  // Glyphs the cache rasterized while recording have to reach the texture before anything draws
+  UpdateFontTexture(Lil::GetContext().ActiveFont);
+  
+  // 1) Size the frame and make sure every stream segment can hold it
+  std::size_t vtxCount = 0, idxCount = 0, instCount = 0;
   for (auto& drawList : Lil::GetDrawLists())
   {
-    glUseProgram(s_Data.ShaderProgram);
-//    GLint ts = glGetUniformLocation(s_Data.ShaderProgram, "u_Texture");
-//    glUniform1i(ts, 0);
-    
-    
-    typedef void (APIENTRYP PFNGLBUFFERSUBDATAPROC)(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
-    glBindBuffer(GL_ARRAY_BUFFER, s_Data.VBO);
-    glBufferSubData(GL_ARRAY_BUFFER,
-                    0,
-                    drawList.VtxArray.GetSize() * sizeof(LilVtx),
-                    &drawList.VtxArray[0]);
+    vtxCount += drawList.VtxArray.GetSize();
+    idxCount += drawList.IdxArray.GetSize();
+    instCount += drawList.RectArray.GetSize();
+  }
+  
+  LilRendererStats& stats = s_Data.Stats;
+  bool replaced = ReserveStreamBuffer(s_Data.Vertices, vtxCount * sizeof(LilVtx));
+  replaced = ReserveStreamBuffer(s_Data.Indices, idxCount * sizeof(LilIdx)) || replaced;
+  ReserveStreamBuffer(s_Data.Instances, instCount * sizeof(LilRectInstance));
+  if (replaced)
+    SetStreamAttributes();
+  
+  stats.VtxCapacity = s_Data.Vertices.SegmentSize;
+  stats.IdxCapacity = s_Data.Indices.SegmentSize;
+  stats.InstanceCapacity = s_Data.Instances.SegmentSize;
+  
+  // 2) Wait until the GPU has released this frame's segment, then write the whole frame into it
+  const unsigned int segment = s_Data.FrameIndex % FramesInFlight;
+  {
+    LIL_PROFILE_SCOPE("LilRenderer::WaitForSegment");
+    WaitForSegment(segment);
+  }
+  
+  {
+    LIL_PROFILE_SCOPE("LilRenderer::Upload");
+    char* vtxDst = MapStreamSegment(s_Data.Vertices, segment, vtxCount * sizeof(LilVtx));
+    PackFrame<LilVtx>(vtxDst, [](const LilDrawList& drawList) -> const LilArray<LilVtx>& { return drawList.VtxArray; });
+    UnmapStreamSegment(s_Data.Vertices, vtxCount * sizeof(LilVtx));
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_Data.IBO);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
-                    0,
-                    drawList.IdxArray.GetSize() * sizeof(LilIdx),
-                    &drawList.IdxArray[0]);
+    char* idxDst = MapStreamSegment(s_Data.Indices, segment, idxCount * sizeof(LilIdx));
+    PackFrame<LilIdx>(idxDst, [](const LilDrawList& drawList) -> const LilArray<LilIdx>& { return drawList.IdxArray; });
+    UnmapStreamSegment(s_Data.Indices, idxCount * sizeof(LilIdx));
     
-    glBindVertexArray(s_Data.VAO);
+    char* instDst = MapStreamSegment(s_Data.Instances, segment, instCount * sizeof(LilRectInstance));
+    PackFrame<LilRectInstance>(instDst, [](const LilDrawList& drawList) -> const LilArray<LilRectInstance>& { return drawList.RectArray; });
+    UnmapStreamSegment(s_Data.Instances, instCount * sizeof(LilRectInstance));
+  }
+  
+  // 3) Draw every list, offsetting its commands by where the list landed in the segment
+  std::size_t vtxBase = segment * s_Data.Vertices.SegmentSize / sizeof(LilVtx);
+  std::size_t idxBase = segment * s_Data.Indices.SegmentSize / sizeof(LilIdx);
+  std::size_t instBase = segment * s_Data.Instances.SegmentSize / sizeof(LilRectInstance);
+  
+  LIL_PROFILE_SCOPE("LilRenderer::Draw");
+  
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  s_State.SetBlend(true);
+  
+  for (auto& drawList : Lil::GetDrawLists())
+  {
+    const bool quadIndexing = drawList.Flags & LilDrawListFlags_QuadIndexing;
     
     for (auto& command : drawList.DrawCmds)
     {
-      //glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, s_Data.TextureID);
-      //if (command.TextureID)
-        //glBindTexture(GL_TEXTURE_2D, command.TextureID);
+      s_State.BindTexture(0, command.TextureID ? command.TextureID : s_Data.TextureID);
+      const bool distanceField = command.TextureID && command.TextureID == s_Data.DistanceFieldTexture;
+      SetClipRect(command.ClipRect, viewport);
+      
+      if (command.InstCount)
+      {
+        // No base instance in GL 3.3, so the per-instance attributes are pointed at the command's first rect
+        const std::size_t base = (instBase + command.InstOffset) * sizeof(LilRectInstance);
+        s_State.UseProgram(distanceField ? s_Data.DistanceFieldInstanceProgram : s_Data.InstanceProgram);
+        s_State.BindVertexArray(s_Data.InstanceVAO);
+        s_State.BindBuffer(GL_ARRAY_BUFFER, s_Data.Instances.ID);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(LilRectInstance), (void*)(base + offsetof(LilRectInstance, Min)));
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(LilRectInstance), (void*)(base + offsetof(LilRectInstance, UV)));
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LilRectInstance), (void*)(base + offsetof(LilRectInstance, Color)));
+        
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(command.InstCount));
+        continue;
+      }
+      
+      s_State.UseProgram(distanceField ? s_Data.DistanceFieldProgram : s_Data.ShaderProgram);
+      
+      if (quadIndexing)
+      {
+        s_State.BindVertexArray(s_Data.QuadVAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES,
+                                 static_cast<int>(command.Size),
+                                 GL_UNSIGNED_SHORT,
+                                 (const void*)(command.IdxOffset * sizeof(unsigned short)),
+                                 static_cast<GLint>(vtxBase + command.VtxOffset));
+        continue;
+      }
       
-      glDrawElements(GL_TRIANGLES, static_cast<int>(command.Size), GL_UNSIGNED_SHORT, (const void*)static_cast<long>(command.IdxOffset));
+      s_State.BindVertexArray(s_Data.VAO);
+      glDrawElementsBaseVertex(GL_TRIANGLES,
+                               static_cast<int>(command.Size),
+                               sizeof(LilIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                               (const void*)((idxBase + command.IdxOffset) * sizeof(LilIdx)),
+                               static_cast<GLint>(vtxBase + command.VtxOffset));
     }
+    
+    vtxBase += drawList.VtxArray.GetSize();
+    idxBase += drawList.IdxArray.GetSize();
+    instBase += drawList.RectArray.GetSize();
   }
   
-  glUseProgram(0);
-  glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  // 4) The segment can be rewritten once the GPU has passed this point
+  s_Data.Fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  ++s_Data.FrameIndex;
+  
+  s_State.UseProgram(0);
+  s_State.BindVertexArray(0);
+  s_State.BindBuffer(GL_ARRAY_BUFFER, 0);
+  
+  stats.StateCalls = s_State.Issued;
+  stats.StateCallsSkipped = s_State.Skipped;
 }
 
 void LilRenderer::OnResize(float width, float height)
@@ -188,3 +769,8 @@ void LilRenderer::OnResize(float width, float height)
   glViewport(0, 0, width, height);
 }
 
+const LilRendererStats& LilRenderer::GetStats()
+{
+  return s_Data.Stats;
+}
+
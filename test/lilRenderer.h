@@ -2,12 +2,31 @@
 
 #include "lilRenderer.h"
 
+#include <lilGUI.h>
+
 #include <glad/glad.h>
 
+#include <cstddef>
+
+struct LilRendererStats
+{
+  std::size_t VtxCapacity, IdxCapacity, InstanceCapacity; // Current GPU buffer sizes in bytes, per frame in flight
+  unsigned int BufferGrowths; // Reallocations since Init, nonzero means the initial sizes were too small
+  
+  bool PersistentMapping; // ARB_buffer_storage ring, otherwise unsynchronized maps guarded by the same fences
+  unsigned int FenceWaits; // Frames that had to check a fence before reusing their ring segment
+  unsigned int FenceStalls; // Fence checks that found the GPU still busy and blocked the CPU
+  
+  unsigned int StateCalls; // GL state calls (binds, enables, ...) End issued last frame
+  unsigned int StateCallsSkipped; // State calls End skipped last frame because nothing would have changed
+};
+
 class LilRenderer
 {
 public:
-  static void Init();
+  // Buffer sizes are in bytes and only a starting point, the buffers grow when a frame outgrows them.
+  // The loader is only needed for entry points past GL 3.3 (glBufferStorage), without it uploads use the fallback path.
+  static void Init(GLADloadproc loadProc = nullptr, std::size_t vertexBufferSize = 250 * 1024, std::size_t indexBufferSize = 50 * 1024);
   static void Terminate();
   
   static void Begin();
@@ -15,11 +34,45 @@ public:
   
   static void OnResize(float width, float height);
   
+  static const LilRendererStats& GetStats();
+  
+  static constexpr unsigned int FramesInFlight = 3;
+  
 private:
+  // One buffer split into FramesInFlight segments, frame N writes segment N % FramesInFlight
+  struct LilStreamBuffer
+  {
+    GLuint ID;
+    std::size_t ElementSize;
+    std::size_t SegmentSize; // Bytes, always a multiple of ElementSize so segments start on an element
+    char* Mapped; // Whole buffer, only while persistently mapped
+  };
+  
   struct LilRendererData
   {
-    GLuint VAO, VBO, IBO, ShaderProgram, TextureID;
+    GLuint VAO, ShaderProgram, TextureID;
+    GLuint QuadVAO, QuadIBO;
+    GLuint InstanceVAO, InstanceProgram;
+    GLuint DistanceFieldProgram, DistanceFieldInstanceProgram;
+    GLuint DistanceFieldTexture; // Font texture holding a distance field, 0 while the font is a bitmap atlas
+    LilArray<LilAtlasRect> AtlasUpdates;
+    
+    LilStreamBuffer Vertices, Indices, Instances;
+    GLsync Fences[FramesInFlight];
+    unsigned int FrameIndex;
+    
+    LilRendererStats Stats;
   };
   
   static LilRendererData s_Data;
+  
+private:
+  static void CreateStreamBuffer(LilStreamBuffer& buffer, std::size_t segmentSize);
+  static void DestroyStreamBuffer(LilStreamBuffer& buffer);
+  static bool ReserveStreamBuffer(LilStreamBuffer& buffer, std::size_t size);
+  static char* MapStreamSegment(LilStreamBuffer& buffer, unsigned int segment, std::size_t size);
+  static void UnmapStreamSegment(LilStreamBuffer& buffer, std::size_t size);
+  static void WaitForSegment(unsigned int segment);
+  static void SetStreamAttributes();
+  static void UpdateFontTexture(LilFont& font);
 };
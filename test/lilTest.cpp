@@ -1,10 +1,12 @@
 #include "lilRenderer.h"
 
 #include <lilGUI.h>
+#include <lilProfiler.h>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <printf.h>
+#include <cstdio>
 
 int main()
 {
@@ -41,7 +43,7 @@ int main()
   }
   
   // 4) Initialize Renderer
-  LilRenderer::Init();
+  LilRenderer::Init((GLADloadproc)glfwGetProcAddress);
   
   // 5) Run Loop
   while (!glfwWindowShouldClose(window))
@@ -53,7 +55,11 @@ int main()
     
     LilRenderer::Begin();
     
-    Lil::Rect(0.0f, 0.0f, 0.5f, 0.5f, 0xff0000ff);
+    {
+      LIL_PROFILE_SCOPE("lilTest::BuildUI");
+      Lil::Rect(0.0f, 0.0f, 0.5f, 0.5f, 0xff0000ff);
+      Lil::Text(-0.9f, 0.9f, "lilGUI", 0.08f);
+    }
     
     LilRenderer::End();
 
@@ -61,6 +67,14 @@ int main()
   }
   
   // 6) Shut Down
+  const LilRendererStats& stats = LilRenderer::GetStats();
+  std::printf("persistent=%d fence_waits=%u fence_stalls=%u buffer_growths=%u state_calls=%u state_calls_skipped=%u\n",
+              stats.PersistentMapping ? 1 : 0, stats.FenceWaits, stats.FenceStalls, stats.BufferGrowths, stats.StateCalls, stats.StateCallsSkipped);
+  
+#ifdef LIL_PROFILE
+  Lil::WriteChromeTrace("lilTest.trace.json");
+#endif
+  
   LilRenderer::Terminate();
   glfwDestroyWindow(window);
   glfwTerminate();